@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+
+#include "../twiboot.h"
+#include "twiboot_app.h"
+
+/* *************************************************************************
+ * twiboot_app_write
+ * ************************************************************************* */
+uint8_t twiboot_app_write(uint8_t bcnt, uint8_t data)
+{
+    static uint8_t cmd;
+
+    switch (bcnt)
+    {
+        case 0:
+            cmd = data;
+            break;
+
+        case 1:
+            if ((cmd == CMD_SWITCH_APPLICATION) && (data == BOOTTYPE_BOOTLOADER))
+            {
+                return 1;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+} /* twiboot_app_write */
+
+
+/* *************************************************************************
+ * twiboot_app_enter_bootloader
+ * ************************************************************************* */
+void twiboot_app_enter_bootloader(void)
+{
+    cli();
+
+    /*
+     * magic is located at the top of the stack, nothing is pushed
+     * until the watchdog resets the device
+     */
+    *(volatile uint16_t *)WARMBOOT_MAGIC_ADDR = WARMBOOT_MAGIC;
+
+    wdt_enable(WDTO_15MS);
+    while (1);
+} /* twiboot_app_enter_bootloader */
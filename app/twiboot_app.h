@@ -0,0 +1,41 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _TWIBOOT_APP_H_
+#define _TWIBOOT_APP_H_
+
+#include <stdint.h>
+
+/*
+ * application side of the twiboot protocol
+ *
+ * Feed every byte received as TWI slave (SLA+W) into twiboot_app_write(),
+ * bcnt counts the received bytes of the current transaction (starting
+ * with 0). When it returns non-zero the master requested the bootloader
+ * (SLA+W, 0x01, 0x00): finish the transaction and call
+ * twiboot_app_enter_bootloader().
+ */
+uint8_t twiboot_app_write(uint8_t bcnt, uint8_t data);
+
+/*
+ * Stores the warm boot magic and resets the device via watchdog.
+ * The bootloader then stays active without a boot timeout.
+ */
+void twiboot_app_enter_bootloader(void) __attribute__((noreturn));
+
+#endif /* _TWIBOOT_APP_H_ */
@@ -0,0 +1,366 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <elf.h>
+
+#include "filedata.h"
+
+#define FILETYPE_UNKNOWN        0
+#define FILETYPE_BINARY         1
+#define FILETYPE_INTELHEX       2
+#define FILETYPE_ELF            3
+
+/* avr-gcc: sections above this address (sram, eeprom, fuses) are not flash */
+#define ELF_FLASH_LIMIT         0x800000
+
+/* *************************************************************************
+ * dbuf_alloc
+ * ************************************************************************* */
+int dbuf_alloc(struct databuf **dbuf, uint32_t size)
+{
+    *dbuf = malloc(sizeof(struct databuf) + size);
+    if (*dbuf == NULL)
+    {
+        perror("dbuf_alloc");
+        return -1;
+    }
+
+    (*dbuf)->size = size;
+    (*dbuf)->length = 0;
+
+    /* unused flash is erased */
+    memset((*dbuf)->data, 0xFF, size);
+    return 0;
+} /* dbuf_alloc */
+
+
+/* *************************************************************************
+ * dbuf_free
+ * ************************************************************************* */
+void dbuf_free(struct databuf *dbuf)
+{
+    free(dbuf);
+} /* dbuf_free */
+
+
+/* *************************************************************************
+ * get_filetype
+ * ************************************************************************* */
+static int get_filetype(const char *filename)
+{
+    const char *ext = filename + (strlen(filename) -4);
+
+    if (ext < filename)
+    {
+        return FILETYPE_UNKNOWN;
+    }
+
+    if (strncmp(ext, ".bin", 4) == 0)
+    {
+        return FILETYPE_BINARY;
+    }
+
+    if (strncmp(ext, ".hex", 4) == 0)
+    {
+        return FILETYPE_INTELHEX;
+    }
+
+    if (strncmp(ext, ".elf", 4) == 0)
+    {
+        return FILETYPE_ELF;
+    }
+
+    return FILETYPE_UNKNOWN;
+} /* get_filetype */
+
+
+/* *************************************************************************
+ * binfile_read
+ * ************************************************************************* */
+static int binfile_read(const char *filename, struct databuf *dbuf)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "binfile_read(): fopen('%s'): %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    dbuf->length = fread(dbuf->data, 1, dbuf->size, fp);
+    if (!feof(fp))
+    {
+        fprintf(stderr, "binfile_read(): '%s' is larger than %u bytes\n", filename, dbuf->size);
+        fclose(fp);
+        return -1;
+    }
+
+    fclose(fp);
+    return 0;
+} /* binfile_read */
+
+
+/* *************************************************************************
+ * hex2byte
+ * ************************************************************************* */
+static int hex2byte(const char *ptr)
+{
+    int i;
+    int result = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        result <<= 4;
+        if (ptr[i] >= '0' && ptr[i] <= '9')
+        {
+            result |= ptr[i] - '0';
+        }
+        else if (ptr[i] >= 'A' && ptr[i] <= 'F')
+        {
+            result |= ptr[i] - 'A' + 0x0A;
+        }
+        else if (ptr[i] >= 'a' && ptr[i] <= 'f')
+        {
+            result |= ptr[i] - 'a' + 0x0A;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return result;
+} /* hex2byte */
+
+
+/* *************************************************************************
+ * hexfile_read
+ * ************************************************************************* */
+static int hexfile_read(const char *filename, struct databuf *dbuf)
+{
+    char line[600];
+    uint32_t segment = 0;
+    int lineno = 0;
+    int result = -1;
+
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "hexfile_read(): fopen('%s'): %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        uint8_t record[256 +5];
+        int len, i;
+        uint8_t checksum = 0;
+
+        lineno++;
+
+        /* skip empty lines */
+        if (line[0] == '\r' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        len = hex2byte(line +1);
+        if (line[0] != ':' || len < 0 || strlen(line) < (size_t)(1 + (len +5) * 2))
+        {
+            fprintf(stderr, "hexfile_read(): invalid record in line %d\n", lineno);
+            goto out;
+        }
+
+        /* bytecount, address (2), type, data (len), checksum */
+        for (i = 0; i < len +5; i++)
+        {
+            int val = hex2byte(line +1 + i * 2);
+            if (val < 0)
+            {
+                fprintf(stderr, "hexfile_read(): invalid character in line %d\n", lineno);
+                goto out;
+            }
+
+            record[i] = val;
+            checksum += val;
+        }
+
+        if (checksum != 0x00)
+        {
+            fprintf(stderr, "hexfile_read(): invalid checksum in line %d\n", lineno);
+            goto out;
+        }
+
+        switch (record[3])
+        {
+            /* data record */
+            case 0x00:
+            {
+                uint32_t address = segment + ((record[1] << 8) | record[2]);
+
+                if ((address + len) > dbuf->size)
+                {
+                    fprintf(stderr, "hexfile_read(): address 0x%04x out of range (line %d)\n",
+                            address, lineno);
+                    goto out;
+                }
+
+                memcpy(dbuf->data + address, record +4, len);
+
+                if (dbuf->length < (address + len))
+                {
+                    dbuf->length = address + len;
+                }
+                break;
+            }
+
+            /* end of file record */
+            case 0x01:
+                result = 0;
+                goto out;
+
+            /* extended segment address record */
+            case 0x02:
+                segment = ((record[4] << 8) | record[5]) << 4;
+                break;
+
+            /* extended linear address record */
+            case 0x04:
+                segment = ((record[4] << 8) | record[5]) << 16;
+                break;
+
+            /* start segment / linear address record */
+            case 0x03:
+            case 0x05:
+                break;
+
+            default:
+                fprintf(stderr, "hexfile_read(): unknown record type 0x%02x in line %d\n",
+                        record[3], lineno);
+                goto out;
+        }
+    }
+
+    fprintf(stderr, "hexfile_read(): no end of file record in '%s'\n", filename);
+
+out:
+    fclose(fp);
+    return result;
+} /* hexfile_read */
+
+
+/* *************************************************************************
+ * elffile_read
+ * ************************************************************************* */
+static int elffile_read(const char *filename, struct databuf *dbuf)
+{
+    Elf32_Ehdr ehdr;
+    int i, result = -1;
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "elffile_read(): fopen('%s'): %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    if ((fread(&ehdr, sizeof(ehdr), 1, fp) != 1) ||
+        (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0) ||
+        (ehdr.e_ident[EI_CLASS] != ELFCLASS32) ||
+        (ehdr.e_ident[EI_DATA] != ELFDATA2LSB) ||
+        (ehdr.e_machine != EM_AVR) ||
+        (ehdr.e_phentsize != sizeof(Elf32_Phdr))
+       )
+    {
+        fprintf(stderr, "elffile_read(): '%s' is not an avr elf file\n", filename);
+        goto out;
+    }
+
+    /* load segments at their physical (flash) address, .data included */
+    for (i = 0; i < ehdr.e_phnum; i++)
+    {
+        Elf32_Phdr phdr;
+
+        if ((fseek(fp, ehdr.e_phoff + i * sizeof(phdr), SEEK_SET) < 0) ||
+            (fread(&phdr, sizeof(phdr), 1, fp) != 1)
+           )
+        {
+            fprintf(stderr, "elffile_read(): failed to read program header %d\n", i);
+            goto out;
+        }
+
+        if ((phdr.p_type != PT_LOAD) || (phdr.p_filesz == 0) ||
+            (phdr.p_paddr >= ELF_FLASH_LIMIT)
+           )
+        {
+            continue;
+        }
+
+        if ((phdr.p_paddr + phdr.p_filesz) > dbuf->size)
+        {
+            fprintf(stderr, "elffile_read(): segment at 0x%04x out of range\n", phdr.p_paddr);
+            goto out;
+        }
+
+        if ((fseek(fp, phdr.p_offset, SEEK_SET) < 0) ||
+            (fread(dbuf->data + phdr.p_paddr, phdr.p_filesz, 1, fp) != 1)
+           )
+        {
+            fprintf(stderr, "elffile_read(): failed to read segment at 0x%04x\n", phdr.p_paddr);
+            goto out;
+        }
+
+        if (dbuf->length < (phdr.p_paddr + phdr.p_filesz))
+        {
+            dbuf->length = phdr.p_paddr + phdr.p_filesz;
+        }
+    }
+
+    result = 0;
+
+out:
+    fclose(fp);
+    return result;
+} /* elffile_read */
+
+
+/* *************************************************************************
+ * file_read
+ * ************************************************************************* */
+int file_read(const char *filename, struct databuf *dbuf)
+{
+    switch (get_filetype(filename))
+    {
+        case FILETYPE_BINARY:
+            return binfile_read(filename, dbuf);
+
+        case FILETYPE_INTELHEX:
+            return hexfile_read(filename, dbuf);
+
+        case FILETYPE_ELF:
+            return elffile_read(filename, dbuf);
+
+        default:
+            fprintf(stderr, "file_read(): unknown filetype of '%s'\n", filename);
+            return -1;
+    }
+} /* file_read */
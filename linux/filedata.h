@@ -0,0 +1,35 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _FILEDATA_H_
+#define _FILEDATA_H_
+
+#include <stdint.h>
+
+struct databuf {
+    uint32_t size;      /* allocation size */
+    uint32_t length;    /* used size */
+    uint8_t data[0];
+};
+
+int dbuf_alloc(struct databuf **dbuf, uint32_t size);
+void dbuf_free(struct databuf *dbuf);
+
+int file_read(const char *filename, struct databuf *dbuf);
+
+#endif /* _FILEDATA_H_ */
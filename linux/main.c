@@ -0,0 +1,1325 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "filedata.h"
+#include "sim.h"
+#include "twb.h"
+
+#define DEFAULT_DEVICE          "/dev/i2c-0"
+#define DEFAULT_ADDRESS         0x29
+#define MAX_DEVICES             16
+#define MAX_BUSES               8
+
+/* bytes per i2c read transaction (i2c-dev limit: 8192) */
+#define READ_CHUNK_SIZE         1024
+
+/* crc block size is 16bit, larger images are verified block by block */
+#define VERIFY_BLOCK_SIZE       0x8000
+
+/* written pages between two updates of the device journal */
+#define JOURNAL_INTERVAL        16
+
+/* trace read covers the largest device ring (64 entries) */
+#define TRACE_READ_SIZE         (64 * TRACE_ENTRY_SIZE)
+
+#define PAGE_SKIP               0
+#define PAGE_WRITE              1
+
+struct flash_config {
+    const char *verify_file;
+    const char *readback_file;
+    const char *write_file;
+    uint32_t stream_pages;
+    uint32_t msg_size;
+    int compress;
+    int force;
+    int erase;
+    int journal;
+    int trace;
+    int stats;
+    int status;
+    int gcall;
+    uint8_t gcall_address;  /* general call (0x00) or TWI_GROUP_ADDRESS */
+    int valid;
+    int warmboot;
+};
+
+struct device_result {
+    int opened;
+    int result;
+    uint32_t pages;         /* written flash pages */
+    uint32_t unchanged;     /* skipped flash pages */
+    uint64_t duration;      /* write time in us */
+};
+
+/* one worker thread per bus, devices on a bus are accessed one by one */
+struct bus_job {
+    const char *device;
+    uint8_t address[MAX_DEVICES];
+    int count;
+
+    const struct flash_config *cfg;
+    struct twiboot twb[MAX_DEVICES];
+    struct device_result stats[MAX_DEVICES];
+    pthread_t thread;
+};
+
+static struct option opts[] =
+{
+    { "address",    1, 0, 'a' },
+    { "device",     1, 0, 'd' },
+    { "verify",     1, 0, 'c' },
+    { "readback",   1, 0, 'r' },
+    { "write",      1, 0, 'w' },
+    { "compress",   0, 0, 'z' },
+    { "force",      0, 0, 'f' },
+    { "erase",      0, 0, 'e' },
+    { "journal",    0, 0, 'j' },
+    { "trace",      0, 0, 't' },
+    { "stats",      0, 0, 'i' },
+    { "status",     0, 0, 'v' },
+    { "stream",     1, 0, 's' },
+    { "msg-size",   1, 0, 'k' },
+    { "gcall",      0, 0, 'g' },
+    { "group",      1, 0, 'G' },
+    { "mark-valid", 0, 0, 'm' },
+    { "bootloader", 0, 0, 'b' },
+    { "help",       0, 0, 'h' },
+    { NULL,         0, 0, 0   }
+};
+
+static const char *usage =
+    "Usage: twiboot [options]\n"
+    "  -a <address>[,<address>..]   - i2c slave address(es) (default: 0x29)\n"
+    "  -d <device>[:<address>,..]   - i2c device (default: /dev/i2c-0), multiple buses\n"
+    "                                 are flashed in parallel, sim:<name> is simulated,\n"
+    "                                 uart:<tty> uses the UART transport\n"
+    "  -c <filename>                - verify flash against file (on-device crc)\n"
+    "  -r <filename>                - verify flash against file (readback)\n"
+    "  -w <filename>                - write flash from file\n"
+    "  -z                           - compress flash pages (run length encoding)\n"
+    "  -f                           - write all pages (also unchanged pages)\n"
+    "  -e                           - erase application flash before write, skip empty pages\n"
+    "  -j                           - resume interrupted write (device update journal)\n"
+    "  -t                           - show device event trace at the end\n"
+    "  -i                           - show device statistics at the end\n"
+    "  -v                           - check write status (on-device verify of every page)\n"
+    "  -s <pages>                   - write up to <pages> flash pages per transaction\n"
+    "  -k <bytes>                   - max. bytes per i2c message (chunked page write)\n"
+    "  -g                           - write flash of all devices using general call\n"
+    "  -G <address>                 - same as -g, using a group address (TWI_GROUP_ADDRESS)\n"
+    "  -m                           - mark application valid after verify\n"
+    "  -b                           - switch running application to bootloader\n"
+    "  -h                           - show this help\n"
+    "\n"
+    "  supported filetypes: intel hex (.hex), elf (.elf), binary (.bin)\n";
+
+/* *************************************************************************
+ * get_time_us
+ * ************************************************************************* */
+static uint64_t get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+} /* get_time_us */
+
+
+/* *************************************************************************
+ * report
+ * ************************************************************************* */
+static void report(const struct twiboot *twb, const char *fmt, ...)
+{
+    char line[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    /* one printf() per line, workers of other buses print concurrently */
+    printf("%s@0x%02x: %s", twb->device, twb->address, line);
+} /* report */
+
+
+/* *************************************************************************
+ * sync_devices
+ * ************************************************************************* */
+static int sync_devices(struct twiboot *twb, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (twb_sync(&twb[i]) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+} /* sync_devices */
+
+
+/* *************************************************************************
+ * check_status
+ * ************************************************************************* */
+static int check_status(struct twiboot *twb, int count)
+{
+    uint8_t status;
+    int i, result = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (twb_read_status(&twb[i], &status) < 0)
+        {
+            return -1;
+        }
+
+        if (status != WRITE_STATUS_OK)
+        {
+            report(&twb[i], "write flash: status 0x%02x%s%s%s -> FAILED\n", status,
+                   (status & WRITE_STATUS_VERIFY_FAILED) ? ", verify failed" : "",
+                   (status & WRITE_STATUS_ADDRESS_REJECTED) ? ", address rejected" : "",
+                   (status & WRITE_STATUS_INCOMPLETE) ? ", compressed page incomplete" : "");
+            result = -1;
+        }
+    }
+
+    return result;
+} /* check_status */
+
+
+/* *************************************************************************
+ * read_vector_page
+ * virtual bootloader section: after a reset the device returns the jump to the
+ * original reset vector instead of the original application vector.
+ * Reads page 0 and returns 1 if this vector is the only difference to the image.
+ * ************************************************************************* */
+static int read_vector_page(struct twiboot *twb, const struct databuf *dbuf, uint8_t *page)
+{
+    uint16_t rst_vector = dbuf->data[0] | (dbuf->data[1] << 8);
+    uint32_t pos;
+    int patched = 0;
+
+    /* original reset vector has to be a RJMP */
+    if (((rst_vector & 0xF000) != 0xC000) ||
+        (twb_read(twb, MEMTYPE_FLASH, 0x0000, page, twb->pagesize) < 0)
+       )
+    {
+        return 0;
+    }
+
+    for (pos = 0; pos < twb->pagesize; pos += 2)
+    {
+        uint16_t vector = page[pos] | (page[pos +1] << 8);
+
+        if ((page[pos] == dbuf->data[pos]) && (page[pos +1] == dbuf->data[pos +1]))
+        {
+            continue;
+        }
+
+        /* one vector (not the reset vector) with a RJMP to the original reset vector */
+        if (patched || (pos == 0) ||
+            (vector != (((rst_vector - pos / 2) & 0x0FFF) | 0xC000))
+           )
+        {
+            return 0;
+        }
+
+        patched = 1;
+    }
+
+    return patched;
+} /* read_vector_page */
+
+
+/* *************************************************************************
+ * plan_pages
+ * ************************************************************************* */
+static void plan_pages(struct twiboot *twb, int count, struct databuf *dbuf,
+                       uint8_t *plan, uint32_t num_pages, int force, int erased)
+{
+    uint16_t crc[num_pages];
+    uint8_t vector_page[twb->pagesize];
+    uint32_t page;
+    int i;
+
+    memset(plan, PAGE_SKIP, num_pages);
+
+    /* erased devices: only pages with data (not 0xFF-only) are written */
+    if (erased && !force)
+    {
+        for (page = 0; page < num_pages; page++)
+        {
+            uint32_t pos;
+
+            for (pos = 0; pos < twb->pagesize; pos++)
+            {
+                if (dbuf->data[page * twb->pagesize + pos] != 0xFF)
+                {
+                    plan[page] = PAGE_WRITE;
+                    break;
+                }
+            }
+        }
+
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (force || (twb_read_page_crc(&twb[i], 0x0000, crc, num_pages) < 0))
+        {
+            memset(plan, PAGE_WRITE, num_pages);
+            return;
+        }
+
+        /* unchanged (e.g. already erased 0xFF-only) pages are skipped */
+        for (page = 0; page < num_pages; page++)
+        {
+            if ((crc[page] != twb_crc16(0xFFFF, dbuf->data + page * twb->pagesize,
+                                        twb->pagesize)) &&
+                ((page != 0) || !read_vector_page(&twb[i], dbuf, vector_page))
+               )
+            {
+                plan[page] = PAGE_WRITE;
+            }
+        }
+    }
+} /* plan_pages */
+
+
+/* *************************************************************************
+ * journal_start
+ * returns the number of pages already written by all devices
+ * ************************************************************************* */
+static int journal_start(struct twiboot *twb, int count, struct databuf *dbuf,
+                         uint32_t num_pages)
+{
+    uint16_t image_id = twb_crc16(0xFFFF, dbuf->data, num_pages * twb->pagesize);
+    uint8_t journal[JOURNAL_LENGTH];
+    uint32_t resume = num_pages;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t committed = 0;
+        uint16_t crc;
+
+        if (twb_read(&twb[i], MEMTYPE_JOURNAL, 0x0000, journal, sizeof(journal)) < 0)
+        {
+            return -1;
+        }
+
+        /* same image, last committed page must still match */
+        if ((((journal[0] << 8) | journal[1]) == image_id) &&
+            ((uint32_t)((journal[2] << 8) | journal[3]) == num_pages))
+        {
+            committed = (journal[4] << 8) | journal[5];
+            if ((committed > num_pages) ||
+                ((committed > 0) &&
+                 ((twb_read_page_crc(&twb[i], (committed -1) * twb->pagesize, &crc, 1) < 0) ||
+                  (crc != twb_crc16(0xFFFF, dbuf->data + (committed -1) * twb->pagesize,
+                                    twb->pagesize)))))
+            {
+                committed = 0;
+            }
+        }
+
+        resume = (committed < resume) ? committed : resume;
+    }
+
+    if (resume != 0)
+    {
+        return resume;
+    }
+
+    /* new update: application stays invalid until all pages are committed */
+    journal[0] = (image_id >> 8) & 0xFF;
+    journal[1] = image_id & 0xFF;
+    journal[2] = (num_pages >> 8) & 0xFF;
+    journal[3] = num_pages & 0xFF;
+    journal[4] = 0x00;
+    journal[5] = 0x00;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((twb_write(&twb[i], MEMTYPE_JOURNAL, 0x0000, journal, sizeof(journal)) < 0) ||
+            (twb_sync(&twb[i]) < 0))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+} /* journal_start */
+
+
+/* *************************************************************************
+ * journal_commit
+ * ************************************************************************* */
+static int journal_commit(struct twiboot *twb, int count, uint32_t committed)
+{
+    uint8_t data[2] = { (committed >> 8) & 0xFF, committed & 0xFF };
+    int i;
+
+    /* pages are committed once written, not when received */
+    if (sync_devices(twb, count) < 0)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (twb_write(&twb[i], MEMTYPE_JOURNAL, 0x0004, data, sizeof(data)) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+} /* journal_commit */
+
+
+/* *************************************************************************
+ * write_flash
+ * ************************************************************************* */
+static int write_flash(struct twiboot *twb, int count, const struct flash_config *cfg,
+                       struct device_result *stats)
+{
+    const char *filename = cfg->write_file;
+    /* a UART can not hold back the next bytes while a page is written */
+    uint32_t stream_pages = twb->uart ? 1 : cfg->stream_pages;
+    int compress = cfg->compress;
+    int gcall = cfg->gcall;
+    struct twiboot writer = *twb;
+    struct databuf *dbuf;
+    uint8_t rle_buf[TWB_RLE_MAXSIZE(256)];
+    uint8_t *plan;
+    uint32_t page, num_pages, pages = 0, bus_bytes = 0, resume = 0, committed = 0;
+    uint64_t start, duration, latency_min = ~0ULL, latency_max = 0;
+    uint64_t stretch_start = 0, stretch_end = 0;
+    int i, result = -1;
+
+    if (dbuf_alloc(&dbuf, twb->flashsize) < 0)
+    {
+        return -1;
+    }
+
+    if (file_read(filename, dbuf) < 0)
+    {
+        goto out;
+    }
+
+    num_pages = (dbuf->length + twb->pagesize -1) / twb->pagesize;
+    if (num_pages == 0)
+    {
+        fprintf(stderr, "write_flash(): empty image '%s'\n", filename);
+        goto out;
+    }
+
+    plan = malloc(num_pages);
+    if (plan == NULL)
+    {
+        perror("write_flash");
+        goto out;
+    }
+
+    if (cfg->journal)
+    {
+        int ret = journal_start(twb, count, dbuf, num_pages);
+        if (ret < 0)
+        {
+            goto out_free;
+        }
+
+        resume = ret;
+        committed = ret;
+        if (resume != 0)
+        {
+            report(twb, "write flash: resume at page %u of %u (journal)\n", resume, num_pages);
+        }
+    }
+
+    /* a resumed update was already erased */
+    if (cfg->erase && (resume == 0))
+    {
+        for (i = 0; i < count; i++)
+        {
+            uint64_t erase_time = get_time_us();
+
+            if (twb_erase(&twb[i], 0x0000, 0) < 0)
+            {
+                goto out_free;
+            }
+
+            report(&twb[i], "erase flash: %llu ms\n",
+                   (unsigned long long)(get_time_us() - erase_time) / 1000);
+        }
+    }
+
+    /* after an interruption the page content is unknown, compare crcs */
+    plan_pages(twb, count, dbuf, plan, num_pages, cfg->force, cfg->erase && (resume == 0));
+    memset(plan, PAGE_SKIP, resume);
+
+    /* status is cleared on read, discard results of previous writes */
+    if (cfg->status)
+    {
+        for (i = 0; i < count; i++)
+        {
+            uint8_t status;
+
+            if (twb_read_status(&twb[i], &status) < 0)
+            {
+                goto out_free;
+            }
+        }
+    }
+
+    /* address NAKs while writing, also while polling every device */
+    for (i = 0; i < count; i++)
+    {
+        twb[i].nak_count = 0;
+        twb[i].nak_time = 0;
+    }
+
+    writer.nak_count = 0;
+    writer.nak_time = 0;
+
+    if (twb->sim != NULL)
+    {
+        sim_stats(twb->sim, twb->address, &stretch_start, &stretch_end);
+    }
+
+    /* all devices receive the same data, but are polled one by one */
+    if (gcall)
+    {
+        writer.address = cfg->gcall_address;
+        writer.gcall = 1;
+    }
+
+    start = get_time_us();
+
+    page = 0;
+    while (page < num_pages)
+    {
+        uint32_t pos = page * twb->pagesize;
+        uint32_t num = 0;
+        uint16_t rle_size = 0;
+        uint64_t latency;
+
+        if (plan[page] == PAGE_SKIP)
+        {
+            page++;
+            continue;
+        }
+
+        /* consecutive pages are written in one streaming transaction (16bit size) */
+        while ((page + num < num_pages) && (plan[page + num] == PAGE_WRITE) &&
+               (num < stream_pages) && ((num +1) * twb->pagesize < 0x10000))
+        {
+            num++;
+        }
+
+        if (compress)
+        {
+            rle_size = twb_rle_encode(rle_buf, dbuf->data + pos, twb->pagesize);
+        }
+
+        /* includes polling until the previous page is written */
+        latency = get_time_us();
+
+        /* use uncompressed write if encoding does not save anything */
+        if (compress && (rle_size < twb->pagesize) &&
+            ((twb->msg_size == 0) || (TWB_HEADER_SIZE(twb) + rle_size <= twb->msg_size)))
+        {
+            if (twb_write(&writer, MEMTYPE_FLASH_RLE, pos, rle_buf, rle_size) < 0)
+            {
+                goto out_free;
+            }
+
+            bus_bytes += rle_size;
+            num = 1;
+        }
+        else
+        {
+            if (twb_write(&writer, MEMTYPE_FLASH, pos, dbuf->data + pos,
+                          num * twb->pagesize) < 0)
+            {
+                goto out_free;
+            }
+
+            bus_bytes += num * twb->pagesize;
+        }
+
+        /* a busy device would miss the next general call write */
+        if (gcall && (sync_devices(twb, count) < 0))
+        {
+            goto out_free;
+        }
+
+        latency = (get_time_us() - latency) / num;
+        latency_min = (latency < latency_min) ? latency : latency_min;
+        latency_max = (latency > latency_max) ? latency : latency_max;
+
+        page += num;
+        pages += num;
+
+        if (cfg->journal && (page - committed >= JOURNAL_INTERVAL))
+        {
+            if (journal_commit(twb, count, page) < 0)
+            {
+                goto out_free;
+            }
+
+            committed = page;
+        }
+    }
+
+    /* poll until the last page is written */
+    if (sync_devices(twb, count) < 0)
+    {
+        goto out_free;
+    }
+
+    if (cfg->journal && (committed != num_pages) &&
+        ((journal_commit(twb, count, num_pages) < 0) || (sync_devices(twb, count) < 0)))
+    {
+        goto out_free;
+    }
+
+    /* every page was compared with the received data by the bootloader */
+    if (cfg->status && (check_status(twb, count) < 0))
+    {
+        goto out_free;
+    }
+
+    duration = get_time_us() - start;
+    if (duration == 0)
+    {
+        duration = 1;
+    }
+
+    stats->pages = pages;
+    stats->unchanged = num_pages - pages;
+    stats->duration = duration;
+
+    report(twb, "write flash: %u pages written, %u pages unchanged in %llu ms\n",
+           pages, num_pages - pages, (unsigned long long)duration / 1000);
+
+    if (pages)
+    {
+        report(twb, "write flash: %.1f pages/s, %.0f bytes/s, page latency min/avg/max: "
+               "%.2f/%.2f/%.2f ms\n",
+               (pages * 1000000.0) / duration,
+               (pages * twb->pagesize * 1000000.0) / duration,
+               latency_min / 1000.0, duration / (pages * 1000.0), latency_max / 1000.0);
+
+        for (i = 0; i < count; i++)
+        {
+            writer.nak_count += twb[i].nak_count;
+            writer.nak_time += twb[i].nak_time;
+        }
+
+        report(twb, "write flash: %u data bytes, %u bytes transferred (%.1f%%), %u address NAKs\n",
+               pages * twb->pagesize, bus_bytes,
+               (bus_bytes * 100.0) / (pages * twb->pagesize),
+               writer.nak_count);
+
+        /* clockstretching is only visible on a simulated bus */
+        if (twb->sim != NULL)
+        {
+            uint64_t nak_time;
+
+            sim_stats(twb->sim, twb->address, &stretch_end, &nak_time);
+            report(twb, "write flash: NAK polling %.2f ms/page, clockstretching %.2f ms/page\n",
+                   writer.nak_time / (pages * 1000.0),
+                   (stretch_end - stretch_start) / (pages * 1000.0));
+        }
+        else
+        {
+            report(twb, "write flash: NAK polling %.2f ms/page\n",
+                   writer.nak_time / (pages * 1000.0));
+        }
+    }
+
+    result = 0;
+
+out_free:
+    free(plan);
+out:
+    dbuf_free(dbuf);
+    return result;
+} /* write_flash */
+
+
+/* *************************************************************************
+ * verify_flash
+ * ************************************************************************* */
+static int verify_flash(struct twiboot *twb, const char *filename)
+{
+    struct databuf *dbuf;
+    uint16_t crc_file = 0, crc_device = 0;
+    uint8_t vector_page[twb->pagesize];
+    uint32_t pos;
+    uint64_t duration;
+    int result = -1;
+
+    if (dbuf_alloc(&dbuf, twb->flashsize) < 0)
+    {
+        return -1;
+    }
+
+    if (file_read(filename, dbuf) < 0)
+    {
+        goto out;
+    }
+
+    if (dbuf->length == 0)
+    {
+        fprintf(stderr, "verify_flash(): invalid image size (%u bytes)\n", dbuf->length);
+        goto out;
+    }
+
+    duration = get_time_us();
+
+    /* stop at the first block that differs */
+    for (pos = 0; (pos < dbuf->length) && (crc_file == crc_device); pos += VERIFY_BLOCK_SIZE)
+    {
+        uint32_t size = dbuf->length - pos;
+
+        if (size > VERIFY_BLOCK_SIZE)
+        {
+            size = VERIFY_BLOCK_SIZE;
+        }
+
+        if (twb_read_crc(twb, pos, size, &crc_device) < 0)
+        {
+            goto out;
+        }
+
+        crc_file = twb_crc16(0xFFFF, dbuf->data + pos, size);
+
+        /* virtual bootloader section after a reset: use the patched application vector */
+        if ((pos == 0) && (crc_file != crc_device) && read_vector_page(twb, dbuf, vector_page))
+        {
+            uint32_t len = (size < twb->pagesize) ? size : twb->pagesize;
+
+            crc_file = twb_crc16(twb_crc16(0xFFFF, vector_page, len), dbuf->data + len, size - len);
+        }
+    }
+
+    duration = get_time_us() - duration;
+
+    report(twb, "verify flash: %u bytes in %llu ms, crc file: 0x%04x, crc device: 0x%04x -> %s\n",
+           dbuf->length, (unsigned long long)duration / 1000, crc_file, crc_device,
+           (crc_file == crc_device) ? "OK" : "FAILED");
+
+    result = (crc_file == crc_device) ? 0 : -1;
+
+out:
+    dbuf_free(dbuf);
+    return result;
+} /* verify_flash */
+
+
+/* *************************************************************************
+ * readback_flash
+ * ************************************************************************* */
+static int readback_flash(struct twiboot *twb, const char *filename)
+{
+    struct databuf *dbuf;
+    uint8_t buf[READ_CHUNK_SIZE];
+    uint32_t pos;
+    uint64_t duration;
+    int result = -1;
+
+    if (dbuf_alloc(&dbuf, twb->flashsize) < 0)
+    {
+        return -1;
+    }
+
+    if (file_read(filename, dbuf) < 0)
+    {
+        goto out;
+    }
+
+    duration = get_time_us();
+
+    for (pos = 0; pos < dbuf->length; pos += sizeof(buf))
+    {
+        uint32_t size = dbuf->length - pos;
+        uint32_t i;
+
+        if (size > sizeof(buf))
+        {
+            size = sizeof(buf);
+        }
+
+        if (twb_read(twb, MEMTYPE_FLASH, pos, buf, size) < 0)
+        {
+            goto out;
+        }
+
+        for (i = 0; i < size; i++)
+        {
+            if (buf[i] != dbuf->data[pos + i])
+            {
+                report(twb, "readback flash: mismatch at 0x%04x (file: 0x%02x, device: 0x%02x) -> FAILED\n",
+                       pos + i, dbuf->data[pos + i], buf[i]);
+                goto out;
+            }
+        }
+    }
+
+    duration = get_time_us() - duration;
+    if (duration == 0)
+    {
+        duration = 1;
+    }
+
+    report(twb, "readback flash: %u bytes in %llu ms (%.0f bytes/s) -> OK\n",
+           dbuf->length, (unsigned long long)duration / 1000,
+           (dbuf->length * 1000000.0) / duration);
+
+    result = 0;
+
+out:
+    dbuf_free(dbuf);
+    return result;
+} /* readback_flash */
+
+
+/* *************************************************************************
+ * mark_valid
+ * ************************************************************************* */
+static int mark_valid(struct twiboot *twb, const char *filename)
+{
+    struct databuf *dbuf;
+    uint8_t appinfo[5];
+    uint32_t size_len = twb->addr24 ? 3 : 2;
+    uint32_t app_size;
+    uint32_t i;
+    int result = -1;
+
+    if (dbuf_alloc(&dbuf, twb->flashsize) < 0)
+    {
+        return -1;
+    }
+
+    if (file_read(filename, dbuf) < 0)
+    {
+        goto out;
+    }
+
+    /* bootloader calculates and stores the crc */
+    if ((twb_write_appinfo(twb, dbuf->length) < 0) ||
+        (twb_read(twb, MEMTYPE_APPINFO, 0x0000, appinfo, size_len +2) < 0)
+       )
+    {
+        goto out;
+    }
+
+    app_size = 0;
+    for (i = 0; i < size_len; i++)
+    {
+        app_size = (app_size << 8) | appinfo[i];
+    }
+
+    report(twb, "application info: %u bytes, crc device: 0x%04x\n",
+           app_size, (appinfo[size_len] << 8) | appinfo[size_len +1]);
+
+    /* incomplete update (journal) or size beyond the bootloader: invalid size is stored */
+    if (app_size != dbuf->length)
+    {
+        fprintf(stderr, "mark_valid(): application info not accepted by device\n");
+        goto out;
+    }
+
+    result = 0;
+
+out:
+    dbuf_free(dbuf);
+    return result;
+} /* mark_valid */
+
+
+/* *************************************************************************
+ * show_trace
+ * ************************************************************************* */
+static void show_trace(struct twiboot *twb)
+{
+    static const char * const names[] = {
+        [TRACE_START]           = "start",
+        [TRACE_STOP]            = "stop",
+        [TRACE_COMMIT_BEGIN]    = "commit begin",
+        [TRACE_COMMIT_END]      = "commit end",
+        [TRACE_NAK_BUSY]        = "nak busy",
+        [TRACE_BUS_ERROR]       = "bus error",
+    };
+
+    uint8_t trace[TRACE_READ_SIZE];
+    uint32_t i;
+
+    if (twb_read(twb, MEMTYPE_TRACE, 0x0000, trace, sizeof(trace)) < 0)
+    {
+        report(twb, "trace: not available (TRACE_SUPPORT)\n");
+        return;
+    }
+
+    for (i = 0; i < sizeof(trace); i += TRACE_ENTRY_SIZE)
+    {
+        const uint8_t *entry = &trace[i];
+        int32_t ticks;
+
+        if (entry[0] == TRACE_NONE)
+        {
+            continue;
+        }
+
+        /* timer ticks since the bootloader start */
+        ticks = ((entry[1] << 8) | entry[2]) * TRACE_TICKS_PER_OVF +
+                entry[3] - (0xFF - TRACE_TICKS_PER_OVF);
+
+        if ((entry[0] < (sizeof(names) / sizeof(names[0]))) && (names[entry[0]] != NULL))
+        {
+            report(twb, "trace: %10.3f ms %s\n", ticks * TRACE_TICK_US / 1000.0, names[entry[0]]);
+        }
+        else
+        {
+            report(twb, "trace: %10.3f ms event 0x%02x\n", ticks * TRACE_TICK_US / 1000.0, entry[0]);
+        }
+    }
+} /* show_trace */
+
+
+/* *************************************************************************
+ * show_stats
+ * ************************************************************************* */
+static void show_stats(struct twiboot *twb)
+{
+    uint8_t stats[STATS_LENGTH];
+    uint8_t cause;
+    uint32_t pages, ticks;
+
+    if (twb_read(twb, MEMTYPE_STATS, 0x0000, stats, sizeof(stats)) < 0)
+    {
+        report(twb, "stats: not available (STATS_SUPPORT)\n");
+        return;
+    }
+
+    /* MCUSR: PORF, EXTRF, BORF, WDRF */
+    cause = stats[STATS_RESET_CAUSE];
+    report(twb, "stats: reset cause 0x%02x%s%s%s%s\n", cause,
+           (cause & 0x01) ? ", power-on" : "",
+           (cause & 0x02) ? ", external" : "",
+           (cause & 0x04) ? ", brown-out" : "",
+           (cause & 0x08) ? ", watchdog" : "");
+
+    pages = (stats[STATS_PAGES] << 8) | stats[STATS_PAGES +1];
+    ticks = ((uint32_t)stats[STATS_SPM_TICKS] << 24) | (stats[STATS_SPM_TICKS +1] << 16) |
+            (stats[STATS_SPM_TICKS +2] << 8) | stats[STATS_SPM_TICKS +3];
+
+    report(twb, "stats: %u pages (%.3f ms/page), %u eeprom bytes, %u busy NAKs, %u bus errors\n",
+           pages, pages ? (ticks * TRACE_TICK_US / 1000.0 / pages) : 0.0,
+           (stats[STATS_EEPROM_BYTES] << 8) | stats[STATS_EEPROM_BYTES +1],
+           (stats[STATS_NAK_BUSY] << 8) | stats[STATS_NAK_BUSY +1],
+           (stats[STATS_BUS_ERRORS] << 8) | stats[STATS_BUS_ERRORS +1]);
+} /* show_stats */
+
+
+/* *************************************************************************
+ * bus_worker
+ * ************************************************************************* */
+static void * bus_worker(void *arg)
+{
+    struct bus_job *job = (struct bus_job *)arg;
+    const struct flash_config *cfg = job->cfg;
+    struct twiboot *twb = job->twb;
+    int i, result = 0;
+
+    for (i = 0; i < job->count; i++)
+    {
+        struct device_result *stats = &job->stats[i];
+
+        stats->result = -1;
+        if (twb_open(&twb[i], job->device, job->address[i], cfg->warmboot) < 0)
+        {
+            result = -1;
+            continue;
+        }
+
+        stats->opened = 1;
+        twb[i].msg_size = cfg->msg_size;
+
+        report(&twb[i], "version %-16s (sig: 0x%02x 0x%02x 0x%02x), "
+               "flash 0x%04x (0x%02x bytes/page), eeprom 0x%04x\n",
+               twb[i].version, twb[i].signature[0], twb[i].signature[1], twb[i].signature[2],
+               twb[i].flashsize, twb[i].pagesize, twb[i].eepromsize);
+
+        /* all devices on the bus receive the same general call data */
+        if (cfg->gcall && (i > 0) &&
+            (memcmp(twb[0].signature, twb[i].signature, sizeof(twb[0].signature)) ||
+             (twb[0].pagesize != twb[i].pagesize) ||
+             (twb[0].flashsize != twb[i].flashsize))
+           )
+        {
+            report(&twb[i], "device differs from device 0x%02x\n", job->address[0]);
+            result = -1;
+        }
+    }
+
+    if (cfg->gcall && (result == 0) && (cfg->write_file != NULL))
+    {
+        result = write_flash(twb, job->count, cfg, &job->stats[0]);
+        for (i = 1; i < job->count; i++)
+        {
+            job->stats[i] = job->stats[0];
+        }
+    }
+
+    for (i = 0; i < job->count; i++)
+    {
+        struct device_result *stats = &job->stats[i];
+
+        /* a failed general call write affects all devices */
+        if (!stats->opened || (cfg->gcall && (result < 0)))
+        {
+            stats->result = -1;
+            continue;
+        }
+
+        stats->result = 0;
+        if ((cfg->write_file != NULL) && !cfg->gcall)
+        {
+            stats->result = write_flash(&twb[i], 1, cfg, stats);
+        }
+
+        if ((stats->result == 0) && (cfg->readback_file != NULL))
+        {
+            stats->result = readback_flash(&twb[i], cfg->readback_file);
+        }
+
+        if ((stats->result == 0) && (cfg->verify_file != NULL))
+        {
+            stats->result = verify_flash(&twb[i], cfg->verify_file);
+
+            /* only a verified image is marked as valid */
+            if ((stats->result == 0) && cfg->valid)
+            {
+                stats->result = mark_valid(&twb[i], cfg->verify_file);
+            }
+        }
+    }
+
+    for (i = 0; i < job->count; i++)
+    {
+        if (job->stats[i].opened)
+        {
+            /* also after a failed write, the trace shows where it stopped */
+            if (cfg->trace)
+            {
+                show_trace(&twb[i]);
+            }
+
+            if (cfg->stats)
+            {
+                show_stats(&twb[i]);
+            }
+
+            twb_close(&twb[i]);
+        }
+    }
+
+    return NULL;
+} /* bus_worker */
+
+
+/* *************************************************************************
+ * parse_addresses
+ * ************************************************************************* */
+static int parse_addresses(const char *arg, uint8_t *address)
+{
+    char *ptr = (char *)arg;
+    int count;
+
+    for (count = 0; count < MAX_DEVICES; count++)
+    {
+        address[count] = strtoul(ptr, &ptr, 0);
+        if (address[count] < 0x08 || address[count] > 0x77)
+        {
+            fprintf(stderr, "invalid i2c address: 0x%02x\n", address[count]);
+            return -1;
+        }
+
+        if (*ptr++ != ',')
+        {
+            break;
+        }
+    }
+
+    if (count++ == MAX_DEVICES)
+    {
+        fprintf(stderr, "too many i2c addresses (max. %d)\n", MAX_DEVICES);
+        return -1;
+    }
+
+    return count;
+} /* parse_addresses */
+
+
+/* *************************************************************************
+ * main
+ * ************************************************************************* */
+int main(int argc, char *argv[])
+{
+    struct flash_config cfg = { .stream_pages = 1 };
+    static struct bus_job jobs[MAX_BUSES];
+    uint8_t address[MAX_DEVICES] = { DEFAULT_ADDRESS };
+    int count = 1;
+    int num_jobs = 0;
+    uint64_t start, duration, bytes = 0;
+    int i, j, result;
+
+    int arg = 0, code = 0;
+    while (code != -1)
+    {
+        code = getopt_long(argc, argv, "a:d:c:r:w:zfejtivs:k:gG:mbh", opts, &arg);
+
+        switch (code)
+        {
+            case 'a':
+                count = parse_addresses(optarg, address);
+                if (count < 0)
+                {
+                    return -1;
+                }
+                break;
+
+            case 'd':
+            {
+                char *sep = strchr(optarg, ':');
+
+                if (num_jobs == MAX_BUSES)
+                {
+                    fprintf(stderr, "too many i2c devices (max. %d)\n", MAX_BUSES);
+                    return -1;
+                }
+
+                jobs[num_jobs].device = optarg;
+
+                /* sim:<name> is a device name, sim:<name>:<address>,.. has addresses */
+                if ((sep != NULL) &&
+                    ((strncmp(optarg, "sim:", 4) == 0) || (strncmp(optarg, "uart:", 5) == 0)))
+                {
+                    sep = strchr(sep +1, ':');
+                }
+
+                if (sep != NULL)
+                {
+                    *sep = '\0';
+                    jobs[num_jobs].count = parse_addresses(sep +1, jobs[num_jobs].address);
+                    if (jobs[num_jobs].count < 0)
+                    {
+                        return -1;
+                    }
+                }
+
+                num_jobs++;
+                break;
+            }
+
+            case 'c':
+                cfg.verify_file = optarg;
+                break;
+
+            case 'r':
+                cfg.readback_file = optarg;
+                break;
+
+            case 'w':
+                cfg.write_file = optarg;
+                break;
+
+            case 'z':
+                cfg.compress = 1;
+                break;
+
+            case 'f':
+                cfg.force = 1;
+                break;
+
+            case 'e':
+                cfg.erase = 1;
+                break;
+
+            case 'j':
+                cfg.journal = 1;
+                break;
+
+            case 't':
+                cfg.trace = 1;
+                break;
+
+            case 'i':
+                cfg.stats = 1;
+                break;
+
+            case 'v':
+                cfg.status = 1;
+                break;
+
+            case 's':
+                cfg.stream_pages = strtoul(optarg, NULL, 0);
+                if ((cfg.stream_pages < 1) || (cfg.stream_pages > 256))
+                {
+                    fprintf(stderr, "invalid number of pages: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'k':
+                cfg.msg_size = strtoul(optarg, NULL, 0);
+                if ((cfg.msg_size < 8) || (cfg.msg_size > 8192))
+                {
+                    fprintf(stderr, "invalid message size: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'g':
+                cfg.gcall = 1;
+                break;
+
+            case 'G':
+                cfg.gcall = 1;
+                cfg.gcall_address = strtoul(optarg, NULL, 0);
+                if ((cfg.gcall_address < 0x08) || (cfg.gcall_address > 0x77))
+                {
+                    fprintf(stderr, "invalid i2c address: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'm':
+                cfg.valid = 1;
+                break;
+
+            case 'b':
+                cfg.warmboot = 1;
+                break;
+
+            case 'h':
+            case '?':
+                fprintf(stderr, "%s", usage);
+                return (code == 'h') ? 0 : -1;
+
+            default:
+                break;
+        }
+    }
+
+    if ((cfg.verify_file == NULL) && (cfg.readback_file == NULL) && (cfg.write_file == NULL) &&
+        !cfg.trace && !cfg.stats)
+    {
+        fprintf(stderr, "%s", usage);
+        return -1;
+    }
+
+    if (num_jobs == 0)
+    {
+        jobs[num_jobs++].device = DEFAULT_DEVICE;
+    }
+
+    /* devices without address list use the -a addresses */
+    for (i = 0; i < num_jobs; i++)
+    {
+        jobs[i].cfg = &cfg;
+        if (jobs[i].count == 0)
+        {
+            memcpy(jobs[i].address, address, sizeof(address));
+            jobs[i].count = count;
+        }
+    }
+
+    start = get_time_us();
+
+    for (i = 0; i < num_jobs; i++)
+    {
+        if (pthread_create(&jobs[i].thread, NULL, bus_worker, &jobs[i]) != 0)
+        {
+            perror("pthread_create");
+            return -1;
+        }
+    }
+
+    for (i = 0; i < num_jobs; i++)
+    {
+        pthread_join(jobs[i].thread, NULL);
+    }
+
+    duration = get_time_us() - start;
+    if (duration == 0)
+    {
+        duration = 1;
+    }
+
+    printf("\n%-24s %-7s %6s %9s %8s %9s  %s\n",
+           "device", "address", "pages", "unchanged", "time ms", "bytes/s", "result");
+
+    result = 0;
+    for (i = 0; i < num_jobs; i++)
+    {
+        for (j = 0; j < jobs[i].count; j++)
+        {
+            struct device_result *stats = &jobs[i].stats[j];
+            uint32_t size = stats->pages * jobs[i].twb[j].pagesize;
+
+            printf("%-24s 0x%02x    %6u %9u %8llu %9.0f  %s\n",
+                   jobs[i].device, jobs[i].address[j], stats->pages, stats->unchanged,
+                   (unsigned long long)stats->duration / 1000,
+                   (stats->duration) ? (size * 1000000.0) / stats->duration : 0.0,
+                   (stats->result == 0) ? "OK" : "FAILED");
+
+            /* general call data is transferred only once per bus */
+            if (!cfg.gcall || (j == 0))
+            {
+                bytes += size;
+            }
+
+            result |= stats->result;
+        }
+    }
+
+    printf("\n%d bus(es), %llu bytes written in %llu ms (%.0f bytes/s aggregate)\n",
+           num_jobs, (unsigned long long)bytes, (unsigned long long)duration / 1000,
+           (bytes * 1000000.0) / duration);
+
+    return (result < 0) ? 1 : 0;
+} /* main */
@@ -0,0 +1,35 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _NATIVE_AVR_BOOT_H_
+#define _NATIVE_AVR_BOOT_H_
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+/* 32bit addresses as the RAMPZ variants of avr-libc */
+void boot_page_fill(uint32_t address, uint16_t data);
+void boot_page_erase(uint32_t address);
+void boot_page_write(uint32_t address);
+
+/* self programming completes immediately */
+#define boot_spm_busy()         0
+#define boot_spm_busy_wait()
+#define boot_rww_enable()
+
+#endif /* _NATIVE_AVR_BOOT_H_ */
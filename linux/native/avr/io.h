@@ -0,0 +1,181 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _NATIVE_AVR_IO_H_
+#define _NATIVE_AVR_IO_H_
+
+/*
+ * native (host) replacement of the avr-libc register definitions,
+ * registers are plain variables defined in native/native.c
+ * NATIVE_USI selects an attiny85 (USI), NATIVE_LARGE an atmega1284p (TWI, 128KiB flash),
+ * default is an atmega328p (TWI, UART)
+ */
+#include <stdint.h>
+
+#define _BV(x)                  (1<<(x))
+
+#define NATIVE_REG(x)           extern volatile uint8_t native_##x
+
+#if defined (NATIVE_USI)
+#define SIGNATURE_0             0x1E
+#define SIGNATURE_1             0x93
+#define SIGNATURE_2             0x0B
+#define SPM_PAGESIZE            64
+#define FLASHEND                0x1FFF
+#define E2END                   0x01FF
+#define RAMEND                  0x025F
+
+NATIVE_REG(USICR);
+NATIVE_REG(USISR);
+NATIVE_REG(USIDR);
+NATIVE_REG(TIFR);
+NATIVE_REG(WDTCR);
+#define USICR                   native_USICR
+#define USISR                   native_USISR
+#define USIDR                   native_USIDR
+#define TIFR                    native_TIFR
+#define WDTCR                   native_WDTCR
+
+#define USISIF                  7
+#define USIOIF                  6
+#define USIPF                   5
+#define USICNT0                 0
+#define USIWM1                  5
+#define USIWM0                  4
+#define USICS1                  3
+#define EE_RDY_vect_num         6
+#define EEMWE                   2
+#define EEWE                    1
+
+#else
+#if defined (NATIVE_LARGE)
+#define SIGNATURE_0             0x1E
+#define SIGNATURE_1             0x97
+#define SIGNATURE_2             0x05
+#define SPM_PAGESIZE            256
+#define FLASHEND                0x1FFFF
+#define E2END                   0x0FFF
+#define RAMEND                  0x40FF
+#else
+#define SIGNATURE_0             0x1E
+#define SIGNATURE_1             0x95
+#define SIGNATURE_2             0x0F
+#define SPM_PAGESIZE            128
+#define FLASHEND                0x7FFF
+#define E2END                   0x03FF
+#define RAMEND                  0x08FF
+#endif /* defined (NATIVE_LARGE) */
+
+NATIVE_REG(TWCR);
+NATIVE_REG(TWSR);
+NATIVE_REG(TWDR);
+NATIVE_REG(TWAR);
+NATIVE_REG(TWAMR);
+NATIVE_REG(TIFR0);
+NATIVE_REG(WDTCSR);
+NATIVE_REG(SPMCSR);
+#define TWCR                    native_TWCR
+#define TWSR                    native_TWSR
+#define TWDR                    native_TWDR
+#define TWAR                    native_TWAR
+#define TWAMR                   native_TWAMR
+#define TIFR0                   native_TIFR0
+#define WDTCSR                  native_WDTCSR
+#define SPMCSR                  native_SPMCSR
+
+#define TWINT                   7
+#define TWEA                    6
+#define TWSTA                   5
+#define TWSTO                   4
+#define TWEN                    2
+#define TWGCE                   0
+#define RWWSRE                  4
+#define EEMPE                   2
+#define EEPE                    1
+
+NATIVE_REG(UCSR0A);
+NATIVE_REG(UCSR0B);
+NATIVE_REG(UBRR0H);
+NATIVE_REG(UBRR0L);
+#define UCSR0A                  native_UCSR0A
+#define UCSR0B                  native_UCSR0B
+#define UBRR0H                  native_UBRR0H
+#define UBRR0L                  native_UBRR0L
+
+/* a byte received by native_uart_rx() is read once (RXC0), other accesses transmit */
+void native_uart_rx(uint8_t data);
+volatile uint8_t * native_udr(void);
+#define UDR0                    (*native_udr())
+
+extern uint8_t native_uart_tx[];
+extern uint16_t native_uart_tx_count;
+
+#define RXC0                    7
+#define TXC0                    6
+#define UDRE0                   5
+#define RXEN0                   4
+#define TXEN0                   3
+#define U2X0                    1
+#endif /* defined (NATIVE_USI) */
+
+NATIVE_REG(MCUSR);
+NATIVE_REG(DDRB);
+NATIVE_REG(PORTB);
+NATIVE_REG(PINB);
+NATIVE_REG(TCCR0B);
+NATIVE_REG(TCNT0);
+NATIVE_REG(EEARL);
+NATIVE_REG(EEARH);
+NATIVE_REG(EECR);
+#define MCUSR                   native_MCUSR
+#define DDRB                    native_DDRB
+#define PORTB                   native_PORTB
+#define PINB                    native_PINB
+#define TCCR0B                  native_TCCR0B
+#define TCNT0                   native_TCNT0
+#define EEARL                   native_EEARL
+#define EEARH                   native_EEARH
+#define EECR                    native_EECR
+
+/* reading EEDR after EERE returns the eeprom content */
+volatile uint8_t * native_eedr(void);
+#define EEDR                    (*native_eedr())
+
+extern volatile uint16_t native_SP;
+#define SP                      native_SP
+
+#define PORTB0                  0
+#define PORTB2                  2
+#define PORTB4                  4
+#define PORTB5                  5
+#define PINB2                   2
+#define EERE                    0
+#define EEPM1                   5
+#define EEPM0                   4
+#define WDCE                    4
+#define WDE                     3
+#define CS02                    2
+#define CS00                    0
+#define TOV0                    0
+
+/* memories of the simulated device */
+extern uint8_t native_flash[FLASHEND +1];
+extern uint8_t native_eeprom[E2END +1];
+extern uint32_t native_eeprom_writes;   /* executed eeprom write operations */
+
+#endif /* _NATIVE_AVR_IO_H_ */
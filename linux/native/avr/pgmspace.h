@@ -0,0 +1,27 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _NATIVE_AVR_PGMSPACE_H_
+#define _NATIVE_AVR_PGMSPACE_H_
+
+#include <avr/io.h>
+
+#define pgm_read_byte_near(x)   (native_flash[(uint16_t)(x)])
+#define pgm_read_byte_far(x)    (native_flash[(uint32_t)(x)])
+
+#endif /* _NATIVE_AVR_PGMSPACE_H_ */
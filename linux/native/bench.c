@@ -0,0 +1,874 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * native build of the bootloader protocol core (TWI_data_write(),
+ * TWI_data_read(), TWI_vect() / usi_statemachine() / UART_vect()) against the
+ * registers of native/avr/io.h. Replays complete protocol transactions
+ * as bus master, checks the results and reports the host cost per byte.
+ */
+#define main twiboot_main
+#include "../../main.c"
+#undef main
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BENCH_LOOPS             1000
+
+/* flash page / eeprom area used by the transactions (outside of vector table) */
+#define BENCH_FLASH_ADDR        (SPM_PAGESIZE * 8)
+#define BENCH_FLASH_STREAM      (SPM_PAGESIZE * 12)
+#define BENCH_FLASH_GCALL       (SPM_PAGESIZE * 14)
+#define BENCH_FLASH_FAR         (0x10000UL + BENCH_FLASH_ADDR)
+#define BENCH_EEPROM_ADDR       0x0010
+#define BENCH_EEPROM_SIZE       16
+
+struct transaction {
+    const char *name;
+    uint8_t wr_data[5 + 2 * SPM_PAGESIZE];
+    uint16_t wr_size;
+    uint16_t rd_size;
+};
+
+static uint8_t rd_data[SPM_PAGESIZE];
+static int perf_fd = -1;
+
+/* SLA+W of a write: own address, general call or group address */
+static uint8_t master_sla;
+
+/* *************************************************************************
+ * slave_idle
+ * background work of the main loop, runs between two bus events
+ * ************************************************************************* */
+static void slave_idle(void)
+{
+#if (USE_PIPELINED_WRITE)
+    flash_poll();
+#endif
+
+#if (USE_PIPELINED_EEPROM)
+    eeprom_poll();
+#endif
+} /* slave_idle */
+
+
+#if (USE_UART)
+/* *************************************************************************
+ * uart_event
+ * ************************************************************************* */
+static void uart_event(uint8_t data)
+{
+    native_uart_rx(data);
+    UART_vect();
+    slave_idle();
+} /* uart_event */
+
+
+/* *************************************************************************
+ * master_transfer
+ * ************************************************************************* */
+static int master_transfer(const uint8_t *wr_data, uint16_t wr_size,
+                           uint8_t *rd_data, uint16_t rd_size)
+{
+    uint16_t i;
+
+    if (wr_size)
+    {
+        native_uart_tx_count = 0;
+        uart_event(master_sla);
+        uart_event((wr_size >> 8) & 0xFF);
+        uart_event(wr_size & 0xFF);
+
+        for (i = 0; i < wr_size; i++)
+        {
+            uart_event(wr_data[i]);
+        }
+
+        if (master_sla != (TWI_SLA | 0x00))
+        {
+            /* no reply to a general call */
+            if (native_uart_tx_count != 0)
+            {
+                return -1;
+            }
+        }
+        /* reply is sent after the write is done */
+        else if ((native_uart_tx_count != 1) || (native_uart_tx[0] != UART_ACK))
+        {
+            return -1;
+        }
+    }
+
+    if (rd_size)
+    {
+        native_uart_tx_count = 0;
+        uart_event(TWI_SLA | 0x01);
+        uart_event((rd_size >> 8) & 0xFF);
+        uart_event(rd_size & 0xFF);
+
+        if (native_uart_tx_count != rd_size)
+        {
+            return -1;
+        }
+
+        memcpy(rd_data, native_uart_tx, rd_size);
+    }
+
+    return 0;
+} /* master_transfer */
+
+#elif defined (TWCR)
+/* *************************************************************************
+ * bus_event
+ * ************************************************************************* */
+static void bus_event(uint8_t status)
+{
+    TWSR = status;
+    TWCR |= (1<<TWINT);
+    TWI_vect();
+    slave_idle();
+} /* bus_event */
+
+
+/* *************************************************************************
+ * master_transfer
+ * ************************************************************************* */
+static int master_transfer(const uint8_t *wr_data, uint16_t wr_size,
+                           uint8_t *rd_data, uint16_t rd_size)
+{
+    uint16_t i;
+
+    /* own address is NAKed until a deferred write is done: poll */
+    for (i = 0; !(TWCR & (1<<TWEA)); i++)
+    {
+        if (i == 0xFFFF)
+        {
+            return -1;
+        }
+
+        slave_idle();
+    }
+
+    if (wr_size)
+    {
+        /* received address is in TWDR (address mask) */
+        TWDR = master_sla;
+        bus_event((master_sla == 0x00) ? 0x70 : 0x60);
+
+        for (i = 0; i < wr_size; i++)
+        {
+            /* ACK of this byte was selected while receiving the previous one */
+            uint8_t status = (TWCR & (1<<TWEA)) ? 0x80 : 0x88;
+
+            /* prev. general call: 0x90 / 0x98 */
+            if (master_sla == 0x00)
+            {
+                status |= 0x10;
+            }
+
+            TWDR = wr_data[i];
+            bus_event(status);
+
+            if (status & 0x08)
+            {
+                return -1;
+            }
+        }
+
+        /* STOP or repeated START */
+        bus_event(0xA0);
+    }
+
+    if (rd_size)
+    {
+        TWDR = TWI_SLA | 0x01;
+        bus_event(0xA8);
+        rd_data[0] = TWDR;
+
+        for (i = 1; i < rd_size; i++)
+        {
+            bus_event(0xB8);
+            rd_data[i] = TWDR;
+        }
+
+        /* last byte NACKed by master */
+        bus_event(0xC0);
+    }
+
+    return 0;
+} /* master_transfer */
+
+#elif defined (USICR)
+/* *************************************************************************
+ * bus_byte
+ * returns the ACK bit sent by the slave
+ * ************************************************************************* */
+static uint8_t bus_byte(uint8_t data)
+{
+    /* data byte shifted in, ACK/NAK prepared */
+    USIDR = data;
+    usi_statemachine(1<<USIOIF);
+    data = USIDR & 0x80;
+
+    /* ACK/NAK bit shifted out */
+    usi_statemachine(1<<USIOIF);
+    slave_idle();
+    return data;
+} /* bus_byte */
+
+
+/* *************************************************************************
+ * bus_address
+ * own address is NAKed until a deferred write is done: poll
+ * ************************************************************************* */
+static int bus_address(uint8_t sla)
+{
+    uint16_t i;
+
+    for (i = 0; i < 0xFFFF; i++)
+    {
+        usi_statemachine(1<<USISIF);
+        if (bus_byte(sla) == 0x00)
+        {
+            return 0;
+        }
+
+        usi_statemachine(1<<USIPF);
+    }
+
+    return -1;
+} /* bus_address */
+
+
+/* *************************************************************************
+ * master_transfer
+ * ************************************************************************* */
+static int master_transfer(const uint8_t *wr_data, uint16_t wr_size,
+                           uint8_t *rd_data, uint16_t rd_size)
+{
+    uint16_t i;
+
+    if (wr_size)
+    {
+        if (bus_address(master_sla) < 0)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < wr_size; i++)
+        {
+            /*
+             * the ACK returned by TWI_data_write() is for the current byte,
+             * the last byte of a message (e.g. boot app) is NAKed
+             */
+            if (bus_byte(wr_data[i]) && (i != wr_size -1))
+            {
+                usi_statemachine(1<<USIPF);
+                return -1;
+            }
+        }
+
+        usi_statemachine(1<<USIPF);
+        slave_idle();
+    }
+
+    if (rd_size)
+    {
+        if (bus_address(TWI_SLA | 0x01) < 0)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < rd_size; i++)
+        {
+            /* data byte shifted out (prepared with the previous ACK) */
+            rd_data[i] = USIDR;
+            usi_statemachine(1<<USIOIF);
+
+            /* master ACK (0) or NACK (1) for the last byte */
+            USIDR = (i == rd_size -1) ? 0x01 : 0x00;
+            usi_statemachine(1<<USIOIF);
+        }
+
+        usi_statemachine(1<<USIPF);
+    }
+
+    return 0;
+} /* master_transfer */
+#endif
+
+
+/* *************************************************************************
+ * perf_open
+ * ************************************************************************* */
+static void perf_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0x00, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    /* not available in every environment, timing is reported anyway */
+    perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+} /* perf_open */
+
+
+/* *************************************************************************
+ * run_transaction
+ * ************************************************************************* */
+static int run_transaction(const struct transaction *t)
+{
+    struct timespec start, end;
+    uint64_t instructions = 0;
+    uint32_t bytes = t->wr_size + t->rd_size;
+    double nsec;
+    int i;
+
+    if (perf_fd >= 0)
+    {
+        ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < BENCH_LOOPS; i++)
+    {
+        if (master_transfer(t->wr_data, t->wr_size, rd_data, t->rd_size) < 0)
+        {
+            printf("%-16s NAK\n", t->name);
+            return -1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (perf_fd >= 0)
+    {
+        ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf_fd, &instructions, sizeof(instructions)) != sizeof(instructions))
+        {
+            instructions = 0;
+        }
+    }
+
+    nsec = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_LOOPS;
+
+    if (instructions)
+    {
+        printf("%-16s %5u bytes %9.1f ns %7.1f ns/byte %7.1f instr/byte\n",
+               t->name, bytes, nsec, nsec / bytes,
+               (double)instructions / (BENCH_LOOPS * bytes));
+    }
+    else
+    {
+        printf("%-16s %5u bytes %9.1f ns %7.1f ns/byte\n",
+               t->name, bytes, nsec, nsec / bytes);
+    }
+
+    return 0;
+} /* run_transaction */
+
+
+/* *************************************************************************
+ * check
+ * ************************************************************************* */
+static int check(const char *name, int ok)
+{
+    if (!ok)
+    {
+        printf("%-16s FAILED\n", name);
+    }
+
+    return ok ? 0 : -1;
+} /* check */
+
+
+#if (APPINFO_SUPPORT)
+/* *************************************************************************
+ * flash_crc
+ * crc16 of the native flash from address 0x0000, reference for the appinfo
+ * ************************************************************************* */
+static uint16_t flash_crc(uint32_t size)
+{
+    uint16_t crc = 0xFFFF;
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        crc = _crc_ccitt_update(crc, native_flash[i]);
+    }
+
+    return crc;
+} /* flash_crc */
+#endif /* (APPINFO_SUPPORT) */
+
+
+/* *************************************************************************
+ * main
+ * ************************************************************************* */
+int main(int argc, char *argv[])
+{
+    struct transaction t;
+    uint8_t page[SPM_PAGESIZE];
+    uint16_t i;
+    int result = 0;
+
+    memset(native_flash, 0xFF, sizeof(native_flash));
+    memset(native_eeprom, 0xFF, sizeof(native_eeprom));
+
+    /* slave address from eeprom, the master addresses TWI_SLA */
+    native_eeprom[ADDRESS_EEPROM_ADDR] = TWI_ADDRESS +1;
+
+    for (i = 0; i < SPM_PAGESIZE; i++)
+    {
+        page[i] = i ^ 0x5A;
+    }
+
+    /* bootloader initialization as in main() */
+#if (VIRTUAL_BOOT_SECTION)
+    read_vectors();
+#endif
+
+    twi_sla = read_slave_address();
+    result |= check("slave address", twi_sla == ((TWI_ADDRESS +1) << 1));
+    master_sla = TWI_SLA | 0x00;
+
+#if (USE_UART)
+    UCSR0A = (1<<UDRE0);
+    printf("native UART slave, %s, %u bytes/page\n",
+           (USE_CLOCKSTRETCH) ? "clockstretching" : "NAK polling", SPM_PAGESIZE);
+#elif defined (TWCR)
+    TWCR = (1<<TWEA) | (1<<TWEN);
+    printf("native TWI slave, %s, %u bytes/page\n",
+           (USE_CLOCKSTRETCH) ? "clockstretching" : "NAK polling", SPM_PAGESIZE);
+#elif defined (USICR)
+    usi_statemachine(0x00);
+    printf("native USI slave, %s, %u bytes/page\n",
+           (USE_CLOCKSTRETCH) ? "clockstretching" : "NAK polling", SPM_PAGESIZE);
+#endif
+
+    perf_open();
+
+    t = (struct transaction) { "version", { CMD_READ_VERSION }, 1, 16 };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(rd_data, VERSION_STRING, sizeof(VERSION_STRING) -1) == 0);
+
+    t = (struct transaction) { "chipinfo", { CMD_ACCESS_MEMORY, MEMTYPE_CHIPINFO, 0x00, 0x00 }, 4, 8 };
+    result |= run_transaction(&t);
+    result |= check(t.name, (rd_data[0] == SIGNATURE_0) && (rd_data[3] == (SPM_PAGESIZE & 0xFF)));
+
+    t = (struct transaction) { "flash write", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF }, 4 + SPM_PAGESIZE, 0 };
+    memcpy(t.wr_data +4, page, SPM_PAGESIZE);
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0);
+
+#if (VERIFY_SUPPORT)
+    t = (struct transaction) { "write status", { CMD_ACCESS_MEMORY, MEMTYPE_WRITE_STATUS, 0x00, 0x00 }, 4, 1 };
+    result |= run_transaction(&t);
+    result |= check(t.name, rd_data[0] == WRITE_STATUS_OK);
+#endif /* (VERIFY_SUPPORT) */
+
+    t = (struct transaction) { "flash read", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF }, 4, SPM_PAGESIZE };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(rd_data, page, SPM_PAGESIZE) == 0);
+
+    /* two pages in one message */
+    t = (struct transaction) { "flash stream write", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               (BENCH_FLASH_STREAM >> 8) & 0xFF, BENCH_FLASH_STREAM & 0xFF }, 4 + 2 * SPM_PAGESIZE, 0 };
+    memcpy(t.wr_data +4, page, SPM_PAGESIZE);
+    memcpy(t.wr_data +4 + SPM_PAGESIZE, page, SPM_PAGESIZE);
+#if (STREAM_SUPPORT)
+    result |= run_transaction(&t);
+    result |= check(t.name, (memcmp(native_flash + BENCH_FLASH_STREAM, page, SPM_PAGESIZE) == 0) &&
+                            (memcmp(native_flash + BENCH_FLASH_STREAM + SPM_PAGESIZE, page, SPM_PAGESIZE) == 0));
+#else
+    /* the byte after the first page is NAKed, only the first page is written */
+    result |= check(t.name, (master_transfer(t.wr_data, t.wr_size, NULL, 0) < 0) &&
+                            (memcmp(native_flash + BENCH_FLASH_STREAM, page, SPM_PAGESIZE) == 0) &&
+                            (native_flash[BENCH_FLASH_STREAM + SPM_PAGESIZE] == 0xFF));
+#endif /* (STREAM_SUPPORT) */
+
+#if (TWI_GENERAL_CALL)
+    /* same page for all devices on the bus, no UART reply */
+    master_sla = TWI_GCALL_SLA;
+    t = (struct transaction) { "gcall flash write", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               (BENCH_FLASH_GCALL >> 8) & 0xFF, BENCH_FLASH_GCALL & 0xFF }, 4 + SPM_PAGESIZE, 0 };
+    memcpy(t.wr_data +4, page, SPM_PAGESIZE);
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_flash + BENCH_FLASH_GCALL, page, SPM_PAGESIZE) == 0);
+
+#if (TWI_GROUP_ADDRESS == 0x00)
+    /* hardware general call of another master (2nd byte bit0 set), not a switch application */
+    t = (struct transaction) { "gcall hardware", { CMD_SWITCH_APPLICATION, BOOTTYPE_APPLICATION }, 2, 0 };
+    master_transfer(t.wr_data, t.wr_size, NULL, 0);
+    result |= check(t.name, cmd != CMD_BOOT_APPLICATION);
+#elif (USE_UART == 0) && defined (TWCR)
+    /* address mask also matches addresses other than own and group address */
+    master_sla = TWI_SLA ^ ((TWI_SLA ^ TWI_GCALL_SLA) & -(TWI_SLA ^ TWI_GCALL_SLA));
+    t = (struct transaction) { "group mask", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               (BENCH_FLASH_GCALL >> 8) & 0xFF, BENCH_FLASH_GCALL & 0xFF }, 4 + SPM_PAGESIZE, 0 };
+    memset(t.wr_data +4, 0x00, SPM_PAGESIZE);
+    result |= check(t.name, (master_transfer(t.wr_data, t.wr_size, NULL, 0) < 0) &&
+                            (memcmp(native_flash + BENCH_FLASH_GCALL, page, SPM_PAGESIZE) == 0));
+#endif /* (TWI_GROUP_ADDRESS == 0x00) */
+    master_sla = TWI_SLA | 0x00;
+#endif /* (TWI_GENERAL_CALL) */
+
+#if (FLASH_ADDR24)
+    /* 3byte address variant: page above 64KiB, different content than the page below */
+    t = (struct transaction) { "flash write far", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH | MEMTYPE_ADDR24,
+                               (BENCH_FLASH_FAR >> 16) & 0xFF, (BENCH_FLASH_FAR >> 8) & 0xFF,
+                               BENCH_FLASH_FAR & 0xFF }, 5 + SPM_PAGESIZE, 0 };
+    for (i = 0; i < SPM_PAGESIZE; i++)
+    {
+        t.wr_data[5 + i] = ~page[i];
+    }
+
+    result |= run_transaction(&t);
+    result |= check(t.name, (memcmp(native_flash + BENCH_FLASH_FAR, t.wr_data +5, SPM_PAGESIZE) == 0) &&
+                            (memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0));
+
+    t = (struct transaction) { "flash read far", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH | MEMTYPE_ADDR24,
+                               (BENCH_FLASH_FAR >> 16) & 0xFF, (BENCH_FLASH_FAR >> 8) & 0xFF,
+                               BENCH_FLASH_FAR & 0xFF }, 5, SPM_PAGESIZE };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(rd_data, native_flash + BENCH_FLASH_FAR, SPM_PAGESIZE) == 0);
+#endif /* (FLASH_ADDR24) */
+
+#if (PARTIAL_WRITE_SUPPORT)
+    /* 4 bytes within the page, the rest of the page is kept */
+    t = (struct transaction) { "flash patch", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               ((BENCH_FLASH_ADDR + 10) >> 8) & 0xFF, (BENCH_FLASH_ADDR + 10) & 0xFF,
+                               0xDE, 0xAD, 0xBE, 0xEF }, 8, 0 };
+    memcpy(page + 10, t.wr_data +4, 4);
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0);
+#endif /* (PARTIAL_WRITE_SUPPORT) */
+
+#if (CHUNKED_WRITE_SUPPORT)
+    /* page assembled from 16 byte messages, then written at once */
+    for (i = 0; i < SPM_PAGESIZE; i++)
+    {
+        page[i] = i ^ 0xA5;
+    }
+
+    for (i = 0; i < SPM_PAGESIZE; i += 16)
+    {
+        t = (struct transaction) { "pagebuf write", { CMD_ACCESS_MEMORY, MEMTYPE_PAGEBUF,
+                                   0x00, i }, 4 + 16, 0 };
+        memcpy(t.wr_data +4, page + i, 16);
+
+        /* timing of the first message only */
+        if (i == 0)
+        {
+            result |= run_transaction(&t);
+        }
+        else if (master_transfer(t.wr_data, t.wr_size, rd_data, 0) < 0)
+        {
+            result |= check(t.name, 0);
+        }
+    }
+
+    t = (struct transaction) { "pagebuf read", { CMD_ACCESS_MEMORY, MEMTYPE_PAGEBUF, 0x00, 0x10 }, 4, 16 };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(rd_data, page + 16, 16) == 0);
+
+    t = (struct transaction) { "pagebuf commit", { CMD_ACCESS_MEMORY, MEMTYPE_PAGEBUF_COMMIT,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF }, 4, 0 };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0);
+#endif /* (CHUNKED_WRITE_SUPPORT) */
+
+#if (CRC_SUPPORT)
+    t = (struct transaction) { "flash crc", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH_CRC,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF }, 4, 2 };
+    result |= run_transaction(&t);
+    {
+        uint16_t crc16 = 0xFFFF;
+
+        for (i = 0; i < SPM_PAGESIZE; i++)
+        {
+            crc16 = _crc_ccitt_update(crc16, page[i]);
+        }
+
+        result |= check(t.name, ((rd_data[0] << 8) | rd_data[1]) == crc16);
+    }
+#endif /* (CRC_SUPPORT) */
+
+#if (RLE_SUPPORT)
+    /* erased page: repeat runs of 0xFF */
+    t = (struct transaction) { "flash rle write", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH_RLE,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF }, 4, 0 };
+    for (i = SPM_PAGESIZE; i > 0; i -= (i > 127) ? 127 : i)
+    {
+        t.wr_data[t.wr_size++] = 0x80 | ((i > 127) ? 127 : i);
+        t.wr_data[t.wr_size++] = 0xFF;
+    }
+
+    result |= run_transaction(&t);
+    memset(page, 0xFF, SPM_PAGESIZE);
+    result |= check(t.name, memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0);
+
+#if (VERIFY_SUPPORT)
+    /* message ends within a run: page is not written, status is set */
+    t = (struct transaction) { "flash rle incomplete", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH_RLE,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF, 0x03, 0x00 }, 6, 0 };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0);
+
+    /* cleared on read: a single transfer */
+    t = (struct transaction) { "flash rle status", { CMD_ACCESS_MEMORY, MEMTYPE_WRITE_STATUS, 0x00, 0x00 }, 4, 1 };
+    result |= check(t.name, (master_transfer(t.wr_data, t.wr_size, rd_data, t.rd_size) == 0) &&
+                            (rd_data[0] == WRITE_STATUS_INCOMPLETE));
+
+    t = (struct transaction) { "flash rle status clear", { CMD_ACCESS_MEMORY, MEMTYPE_WRITE_STATUS, 0x00, 0x00 }, 4, 1 };
+    result |= run_transaction(&t);
+    result |= check(t.name, rd_data[0] == WRITE_STATUS_OK);
+#endif /* (VERIFY_SUPPORT) */
+#endif /* (RLE_SUPPORT) */
+
+#if (ERASE_SUPPORT)
+    /* one page, the following page is kept */
+    memset(native_flash + BENCH_FLASH_ADDR, 0x00, 2 * SPM_PAGESIZE);
+    t = (struct transaction) { "flash erase", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH_ERASE,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF,
+                               0x00, 0x01 }, 6, 0 };
+    result |= run_transaction(&t);
+    memset(page, 0xFF, SPM_PAGESIZE);
+    result |= check(t.name, (memcmp(native_flash + BENCH_FLASH_ADDR, page, SPM_PAGESIZE) == 0) &&
+                            (native_flash[BENCH_FLASH_ADDR + SPM_PAGESIZE] == 0x00));
+
+    /* everything up to the bootloader section */
+    t = (struct transaction) { "flash erase all", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH_ERASE,
+                               0x00, 0x00 }, 4, 0 };
+    result |= run_transaction(&t);
+    {
+        uint32_t addr_end = BOOTLOADER_START;
+        uint32_t addr_start = 0;
+
+#if (VIRTUAL_BOOT_SECTION)
+        /* vector page is written with the bootloader reset vector */
+        uint16_t rst_vector = OPCODE_RJMP(BOOTLOADER_START -1);
+
+        result |= check(t.name, (native_flash[RSTVECT_ADDR] == (rst_vector & 0xFF)) &&
+                                (native_flash[RSTVECT_ADDR +1] == (rst_vector >> 8)));
+        addr_start = SPM_PAGESIZE;
+#endif /* (VIRTUAL_BOOT_SECTION) */
+
+        while ((addr_start < addr_end) && (native_flash[addr_start] == 0xFF))
+        {
+            addr_start++;
+        }
+
+        result |= check(t.name, addr_start == addr_end);
+    }
+#endif /* (ERASE_SUPPORT) */
+
+#if (VIRTUAL_BOOT_SECTION) && (PARTIAL_WRITE_SUPPORT)
+    {
+        /* vector page of an application, reset vector jumps to word 0x0100 */
+        uint16_t app_rst = OPCODE_RJMP(0x0100 -1);
+        uint16_t app_vector = OPCODE_RJMP(app_rst - APPVECT_NUM);
+
+        t = (struct transaction) { "vector write", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                                   0x00, 0x00 }, 4 + SPM_PAGESIZE, 0 };
+        for (i = 0; i < SPM_PAGESIZE; i++)
+        {
+            t.wr_data[4 + i] = i ^ 0x3C;
+        }
+
+        t.wr_data[4 + RSTVECT_ADDR] = (app_rst & 0xFF);
+        t.wr_data[4 + RSTVECT_ADDR +1] = (app_rst >> 8);
+        memcpy(page, t.wr_data +4, SPM_PAGESIZE);
+
+        result |= run_transaction(&t);
+        result |= check(t.name, (native_flash[APPVECT_ADDR] == (app_vector & 0xFF)) &&
+                                (native_flash[APPVECT_ADDR +1] == (app_vector >> 8)));
+
+        /* after a reset only the application vector reads as patched */
+        read_vectors();
+        page[APPVECT_ADDR] = (app_vector & 0xFF);
+        page[APPVECT_ADDR +1] = (app_vector >> 8);
+
+        t = (struct transaction) { "vector reset", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                                   0x00, 0x00 }, 4, SPM_PAGESIZE };
+        result |= run_transaction(&t);
+        result |= check(t.name, memcmp(rd_data, page, SPM_PAGESIZE) == 0);
+
+        /* partial write of the vector page keeps the jump to the application */
+        t = (struct transaction) { "vector patch", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                                   0x00, SPM_PAGESIZE /2, 0xDE, 0xAD, 0xBE, 0xEF }, 8, 0 };
+        memcpy(page + SPM_PAGESIZE /2, t.wr_data +4, 4);
+        result |= run_transaction(&t);
+        result |= check(t.name, (memcmp(native_flash + SPM_PAGESIZE /2, t.wr_data +4, 4) == 0) &&
+                                (native_flash[APPVECT_ADDR] == (app_vector & 0xFF)) &&
+                                (native_flash[APPVECT_ADDR +1] == (app_vector >> 8)));
+
+        read_vectors();
+        t = (struct transaction) { "vector read", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                                   0x00, 0x00 }, 4, SPM_PAGESIZE };
+        result |= run_transaction(&t);
+        result |= check(t.name, memcmp(rd_data, page, SPM_PAGESIZE) == 0);
+    }
+#endif /* (VIRTUAL_BOOT_SECTION) && (PARTIAL_WRITE_SUPPORT) */
+
+    t = (struct transaction) { "eeprom write", { CMD_ACCESS_MEMORY, MEMTYPE_EEPROM,
+                               0x00, BENCH_EEPROM_ADDR }, 4 + BENCH_EEPROM_SIZE, 0 };
+    memcpy(t.wr_data +4, VERSION_STRING "----", BENCH_EEPROM_SIZE);
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_eeprom + BENCH_EEPROM_ADDR, t.wr_data +4, BENCH_EEPROM_SIZE) == 0);
+
+#if (USE_EEPROM_UPDATE)
+    /* same content again: no eeprom write operation at all */
+    t.name = "eeprom update";
+    native_eeprom_writes = 0;
+    result |= run_transaction(&t);
+    result |= check(t.name, native_eeprom_writes == 0);
+#endif /* (USE_EEPROM_UPDATE) */
+
+    t = (struct transaction) { "eeprom read", { CMD_ACCESS_MEMORY, MEMTYPE_EEPROM,
+                               0x00, BENCH_EEPROM_ADDR }, 4, BENCH_EEPROM_SIZE };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(rd_data, VERSION_STRING "----", BENCH_EEPROM_SIZE) == 0);
+
+#if (JOURNAL_SUPPORT)
+    /* image 0x1234, 2 pages, 1 page committed */
+    t = (struct transaction) { "journal write", { CMD_ACCESS_MEMORY, MEMTYPE_JOURNAL,
+                               0x00, 0x00, 0x12, 0x34, 0x00, 0x02, 0x00, 0x01 }, 4 + JOURNAL_LENGTH, 0 };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(native_eeprom + JOURNAL_EEPROM_ADDR, t.wr_data +4,
+                                   JOURNAL_LENGTH) == 0);
+
+    t = (struct transaction) { "journal read", { CMD_ACCESS_MEMORY, MEMTYPE_JOURNAL,
+                               0x00, 0x02 }, 4, 4 };
+    result |= run_transaction(&t);
+    result |= check(t.name, (rd_data[1] == 0x02) && (rd_data[3] == 0x01));
+
+#if (APPINFO_SUPPORT)
+    /* incomplete update: invalid size is stored */
+    /* application size 0x0100 (msb first, 2 or 3 bytes) */
+    t = (struct transaction) { "appinfo invalid", { CMD_ACCESS_MEMORY, MEMTYPE_APPINFO,
+                               0x00, 0x00 }, 4 + APPINFO_SIZE_LENGTH, 0 };
+    t.wr_data[4 + APPINFO_SIZE_LENGTH -2] = 0x01;
+    result |= run_transaction(&t);
+    result |= check(t.name, (native_eeprom[APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH -2] == 0x00) &&
+                            (native_eeprom[APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH -1] == 0x00));
+
+    t = (struct transaction) { "journal commit", { CMD_ACCESS_MEMORY, MEMTYPE_JOURNAL,
+                               0x00, 0x04, 0x00, 0x02 }, 6, 0 };
+    result |= run_transaction(&t);
+
+    t = (struct transaction) { "appinfo valid", { CMD_ACCESS_MEMORY, MEMTYPE_APPINFO,
+                               0x00, 0x00 }, 4 + APPINFO_SIZE_LENGTH, 0 };
+    t.wr_data[4 + APPINFO_SIZE_LENGTH -2] = 0x01;
+    result |= run_transaction(&t);
+    boot_timeout = TIMER_MSEC2IRQCNT(TIMEOUT_MS);
+    check_appinfo();
+    result |= check(t.name, (native_eeprom[APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH -2] == 0x01) &&
+                            (boot_timeout == 1) &&
+                            (((native_eeprom[E2END -1] << 8) | native_eeprom[E2END]) == flash_crc(0x100)));
+
+    t = (struct transaction) { "appinfo read", { CMD_ACCESS_MEMORY, MEMTYPE_APPINFO,
+                               0x00, 0x00 }, 4, APPINFO_LENGTH };
+    result |= run_transaction(&t);
+    result |= check(t.name, memcmp(rd_data, native_eeprom + APPINFO_EEPROM_ADDR, APPINFO_LENGTH) == 0);
+
+#if (APPINFO_FULL_CHECK)
+    /* flash changed without the bootloader: crc16 mismatch, valid size */
+    native_flash[0x80] ^= 0x01;
+    boot_timeout = TIMER_MSEC2IRQCNT(TIMEOUT_MS);
+    check_appinfo();
+    result |= check("appinfo corrupt", boot_timeout == 0);
+    native_flash[0x80] ^= 0x01;
+#endif /* (APPINFO_FULL_CHECK) */
+
+    /* flash write after the application info */
+    t = (struct transaction) { "appinfo flash write", { CMD_ACCESS_MEMORY, MEMTYPE_FLASH,
+                               (BENCH_FLASH_ADDR >> 8) & 0xFF, BENCH_FLASH_ADDR & 0xFF }, 4 + SPM_PAGESIZE, 0 };
+    memset(t.wr_data +4, 0x5A, SPM_PAGESIZE);
+    result |= run_transaction(&t);
+    check_appinfo();
+    result |= check(t.name, (native_eeprom[APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH -2] == 0x00) &&
+                            (native_eeprom[APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH -1] == 0x00) &&
+                            (boot_timeout == 0));
+
+#if (FLASH_ADDR24)
+    /* application above 64KiB, the far page now differs from the page 64KiB below */
+    t = (struct transaction) { "appinfo far", { CMD_ACCESS_MEMORY, MEMTYPE_APPINFO, 0x00, 0x00,
+                               ((BENCH_FLASH_FAR + SPM_PAGESIZE) >> 16) & 0xFF,
+                               ((BENCH_FLASH_FAR + SPM_PAGESIZE) >> 8) & 0xFF,
+                               (BENCH_FLASH_FAR + SPM_PAGESIZE) & 0xFF }, 7, 0 };
+    result |= run_transaction(&t);
+    result |= check(t.name, (memcmp(native_eeprom + APPINFO_EEPROM_ADDR, t.wr_data +4, 3) == 0) &&
+                            (((native_eeprom[E2END -1] << 8) | native_eeprom[E2END]) ==
+                             flash_crc(BENCH_FLASH_FAR + SPM_PAGESIZE)));
+#endif /* (FLASH_ADDR24) */
+#endif /* (APPINFO_SUPPORT) */
+#endif /* (JOURNAL_SUPPORT) */
+
+#if (TRACE_SUPPORT)
+    /* newest entry: start of the trace read itself */
+    t = (struct transaction) { "trace read", { CMD_ACCESS_MEMORY, MEMTYPE_TRACE,
+                               0x00, 0x00 }, 4, TRACE_ENTRIES * TRACE_ENTRY_SIZE };
+    result |= run_transaction(&t);
+    i = TRACE_ENTRIES -1;
+#if (USE_PIPELINED_WRITE)
+    /* the last page write ends in the main loop, after the start of the next message */
+    if (rd_data[i * TRACE_ENTRY_SIZE] == TRACE_COMMIT_END)
+    {
+        i--;
+    }
+#endif
+    result |= check(t.name, rd_data[i * TRACE_ENTRY_SIZE] == TRACE_START);
+#endif /* (TRACE_SUPPORT) */
+
+#if (STATS_SUPPORT)
+    t = (struct transaction) { "stats read", { CMD_ACCESS_MEMORY, MEMTYPE_STATS,
+                               0x00, 0x00 }, 4, STATS_LENGTH };
+    result |= run_transaction(&t);
+    result |= check(t.name, (rd_data[STATS_PAGES +1] != 0x00) &&
+                            (rd_data[STATS_EEPROM_BYTES +1] != 0x00));
+#endif /* (STATS_SUPPORT) */
+
+    t = (struct transaction) { "boot app", { CMD_SWITCH_APPLICATION, BOOTTYPE_APPLICATION }, 2, 0 };
+    result |= run_transaction(&t);
+    result |= check(t.name, cmd == CMD_BOOT_APPLICATION);
+
+    if (perf_fd < 0)
+    {
+        printf("(instruction counter not available)\n");
+    }
+
+    printf("%s\n", (result == 0) ? "all transactions OK" : "FAILED");
+    return (result == 0) ? 0 : 1;
+} /* main */
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/io.h>
+#include <avr/boot.h>
+
+#define NATIVE_REG_DEF(x)       volatile uint8_t native_##x
+
+#if defined (NATIVE_USI)
+NATIVE_REG_DEF(USICR);
+NATIVE_REG_DEF(USISR);
+NATIVE_REG_DEF(USIDR);
+NATIVE_REG_DEF(TIFR);
+NATIVE_REG_DEF(WDTCR);
+#define EEPROM_WRITE_BIT        EEWE
+#else
+NATIVE_REG_DEF(TWCR);
+NATIVE_REG_DEF(TWSR);
+NATIVE_REG_DEF(TWDR);
+NATIVE_REG_DEF(TWAR);
+NATIVE_REG_DEF(TWAMR);
+NATIVE_REG_DEF(TIFR0);
+NATIVE_REG_DEF(WDTCSR);
+NATIVE_REG_DEF(SPMCSR);
+NATIVE_REG_DEF(UCSR0A);
+NATIVE_REG_DEF(UCSR0B);
+NATIVE_REG_DEF(UBRR0H);
+NATIVE_REG_DEF(UBRR0L);
+#define EEPROM_WRITE_BIT        EEPE
+
+static volatile uint8_t native_UDR0;
+
+uint8_t native_uart_tx[SPM_PAGESIZE +1];
+uint16_t native_uart_tx_count;
+#endif /* defined (NATIVE_USI) */
+
+NATIVE_REG_DEF(MCUSR);
+NATIVE_REG_DEF(DDRB);
+NATIVE_REG_DEF(PORTB);
+NATIVE_REG_DEF(PINB);
+NATIVE_REG_DEF(TCCR0B);
+NATIVE_REG_DEF(TCNT0);
+NATIVE_REG_DEF(EEARL);
+NATIVE_REG_DEF(EEARH);
+NATIVE_REG_DEF(EECR);
+volatile uint16_t native_SP;
+
+uint8_t native_flash[FLASHEND +1];
+uint8_t native_eeprom[E2END +1];
+uint32_t native_eeprom_writes;
+
+static volatile uint8_t native_EEDR;
+static uint8_t page_buffer[SPM_PAGESIZE];
+
+/* *************************************************************************
+ * native_eedr
+ * ************************************************************************* */
+volatile uint8_t * native_eedr(void)
+{
+    if (EECR & (1<<EERE))
+    {
+        native_EEDR = native_eeprom[((EEARH << 8) | EEARL) & E2END];
+        EECR &= ~(1<<EERE);
+    }
+
+    return &native_EEDR;
+} /* native_eedr */
+
+
+#if !defined (NATIVE_USI)
+/* *************************************************************************
+ * native_uart_rx
+ * ************************************************************************* */
+void native_uart_rx(uint8_t data)
+{
+    native_UDR0 = data;
+    UCSR0A |= (1<<RXC0);
+} /* native_uart_rx */
+
+
+/* *************************************************************************
+ * native_udr
+ * ************************************************************************* */
+volatile uint8_t * native_udr(void)
+{
+    if (UCSR0A & (1<<RXC0))
+    {
+        UCSR0A &= ~(1<<RXC0);
+        return &native_UDR0;
+    }
+
+    /* transmitted bytes are collected, the buffer wraps around */
+    return &native_uart_tx[native_uart_tx_count++ % sizeof(native_uart_tx)];
+} /* native_udr */
+#endif /* !defined (NATIVE_USI) */
+
+
+/* *************************************************************************
+ * eeprom_busy_wait
+ * ************************************************************************* */
+void eeprom_busy_wait(void)
+{
+    if (EECR & (1<<EEPROM_WRITE_BIT))
+    {
+        uint8_t *p = &native_eeprom[((EEARH << 8) | EEARL) & E2END];
+
+        /* EEPM1:0 - erase and write, erase only, write only */
+        switch ((EECR >> EEPM0) & 0x03)
+        {
+            case 0x01:
+                *p = 0xFF;
+                break;
+
+            case 0x02:
+                *p &= native_EEDR;
+                break;
+
+            default:
+                *p = native_EEDR;
+                break;
+        }
+
+        native_eeprom_writes++;
+        EECR &= ~((1<<EEPROM_WRITE_BIT) | (1<<(EEPROM_WRITE_BIT +1)));
+    }
+} /* eeprom_busy_wait */
+
+
+/* *************************************************************************
+ * eeprom_is_ready
+ * ************************************************************************* */
+int eeprom_is_ready(void)
+{
+    eeprom_busy_wait();
+    return 1;
+} /* eeprom_is_ready */
+
+
+/* *************************************************************************
+ * boot_page_fill
+ * ************************************************************************* */
+void boot_page_fill(uint32_t address, uint16_t data)
+{
+    address &= (SPM_PAGESIZE -2);
+    page_buffer[address] = data & 0xFF;
+    page_buffer[address +1] = (data >> 8) & 0xFF;
+} /* boot_page_fill */
+
+
+/* *************************************************************************
+ * boot_page_erase
+ * ************************************************************************* */
+void boot_page_erase(uint32_t address)
+{
+    memset(native_flash + (address & FLASHEND & ~(SPM_PAGESIZE -1)), 0xFF, SPM_PAGESIZE);
+} /* boot_page_erase */
+
+
+/* *************************************************************************
+ * boot_page_write
+ * ************************************************************************* */
+void boot_page_write(uint32_t address)
+{
+    memcpy(native_flash + (address & FLASHEND & ~(SPM_PAGESIZE -1)), page_buffer, SPM_PAGESIZE);
+    memset(page_buffer, 0xFF, SPM_PAGESIZE);
+} /* boot_page_write */
@@ -0,0 +1,770 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../twiboot.h"
+#include "twb.h"
+#include "sim.h"
+
+/* behavioral model of the twiboot protocol for testing the host tool,
+ * a reimplementation that does not run main.c: keep it in sync with main.c
+ */
+#define SIM_MAX_BUSES           16
+#define SIM_BUS_SPEED           100     /* kHz */
+
+#define SIM_VERSION             "TWIBOOT v3.2"
+#define SIM_MAX_FLASHSIZE       0x3FC00
+#define SIM_MAX_EEPROMSIZE      0x1000
+#define SIM_MAX_PAGESIZE        256
+
+/* assumed timing of the model, not measured:
+ * page erase, page erase + page write, eeprom byte erase + write, eeprom erase or write only
+ */
+#define SIM_FLASH_ERASE_US      4500
+#define SIM_FLASH_WRITE_US      (2 * SIM_FLASH_ERASE_US)
+#define SIM_EEPROM_WRITE_US     3400
+#define SIM_EEPROM_SPLIT_US     1800
+
+/* crc16 of one flash byte (~24 cycles at 8MHz), while SCL is stretched (crc read)
+ * or the address is NAKed (application info write)
+ */
+#define SIM_CRC_BYTE_NS         3000
+
+/* supported MCUs with 512 words bootloader (see Makefile) */
+struct sim_mcu {
+    const char *name;
+    uint8_t signature[3];
+    uint16_t pagesize;
+    uint32_t flashsize;     /* BOOTLOADER_START */
+    uint16_t eepromsize;
+    int clockstretch;       /* USE_CLOCKSTRETCH */
+    int eepm;               /* EEPROM erase only / write only modes */
+};
+
+static const struct sim_mcu sim_mcus[] = {
+    { "atmega328p", { 0x1E, 0x95, 0x0F }, 128, 0x7C00, 0x0400, 0, 1 },
+    { "atmega168",  { 0x1E, 0x94, 0x06 }, 128, 0x3C00, 0x0200, 0, 1 },
+    { "atmega88",   { 0x1E, 0x93, 0x0A },  64, 0x1C00, 0x0200, 0, 1 },
+    { "atmega8",    { 0x1E, 0x93, 0x07 },  64, 0x1C00, 0x0200, 0, 0 },
+    { "attiny85",   { 0x1E, 0x93, 0x0B },  64, 0x1C00, 0x0200, 1, 1 },
+    { "atmega1284p", { 0x1E, 0x97, 0x05 }, 256, 0x1FC00, 0x1000, 0, 1 },
+    { "atmega2560", { 0x1E, 0x98, 0x01 }, 256, 0x3FC00, 0x1000, 0, 1 },
+};
+
+/* application info: 2byte size (3byte above 64KiB flash), 2byte crc16 */
+#define SIM_APPINFO_SIZE_LEN(mcu)   (((mcu)->flashsize > 0xFFFF) ? 3 : 2)
+#define SIM_APPINFO_LEN(mcu)        (SIM_APPINFO_SIZE_LEN(mcu) +2)
+
+struct sim_device {
+    uint8_t flash[SIM_MAX_FLASHSIZE];
+    uint8_t eeprom[SIM_MAX_EEPROMSIZE];
+    uint8_t pagebuf[SIM_MAX_PAGESIZE];
+
+    uint8_t write_status;   /* WRITE_STATUS_* since last read */
+    uint64_t busy_until;    /* NAK until page/eeprom write is completed */
+    uint64_t stretch_us;    /* statistics */
+    uint64_t nak_us;
+};
+
+struct sim_bus {
+    char name[32];
+    int refcount;
+
+    const struct sim_mcu *mcu;
+    uint32_t speed;         /* kHz */
+
+    struct sim_device *device[128];
+};
+
+static struct sim_bus sim_buses[SIM_MAX_BUSES];
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* *************************************************************************
+ * sim_time_us
+ * ************************************************************************* */
+static uint64_t sim_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+} /* sim_time_us */
+
+
+/* *************************************************************************
+ * sim_sleep_us
+ * ************************************************************************* */
+static void sim_sleep_us(uint64_t usec)
+{
+    struct timespec ts = { usec / 1000000, (usec % 1000000) * 1000 };
+
+    nanosleep(&ts, NULL);
+} /* sim_sleep_us */
+
+
+/* *************************************************************************
+ * sim_open
+ * ************************************************************************* */
+struct sim_bus * sim_open(const char *name, uint8_t address)
+{
+    struct sim_bus *bus = NULL;
+    int i;
+
+    pthread_mutex_lock(&sim_lock);
+
+    for (i = 0; i < SIM_MAX_BUSES; i++)
+    {
+        if ((sim_buses[i].refcount != 0) && (strcmp(sim_buses[i].name, name) == 0))
+        {
+            bus = &sim_buses[i];
+            break;
+        }
+
+        if ((sim_buses[i].refcount == 0) && (bus == NULL))
+        {
+            bus = &sim_buses[i];
+        }
+    }
+
+    if ((bus == NULL) || (address == 0x00) || (address > 0x7F))
+    {
+        errno = (bus == NULL) ? ENOMEM : EINVAL;
+        bus = NULL;
+        goto out;
+    }
+
+    if (bus->refcount == 0)
+    {
+        const char *speed = strchr(name, '@');
+
+        memset(bus, 0x00, sizeof(struct sim_bus));
+        snprintf(bus->name, sizeof(bus->name), "%s", name);
+
+        /* <mcu>[@<kHz>], unknown names are an atmega328p at 100kHz */
+        bus->mcu = &sim_mcus[0];
+        for (i = 0; i < (int)(sizeof(sim_mcus) / sizeof(sim_mcus[0])); i++)
+        {
+            size_t len = (speed != NULL) ? (size_t)(speed - name) : strlen(name);
+
+            if ((strlen(sim_mcus[i].name) == len) && (strncmp(name, sim_mcus[i].name, len) == 0))
+            {
+                bus->mcu = &sim_mcus[i];
+            }
+        }
+
+        bus->speed = (speed != NULL) ? strtoul(speed +1, NULL, 0) : SIM_BUS_SPEED;
+        if ((bus->speed == 0) || (bus->speed > 1000))
+        {
+            bus->speed = SIM_BUS_SPEED;
+        }
+    }
+
+    if (bus->device[address] == NULL)
+    {
+        bus->device[address] = malloc(sizeof(struct sim_device));
+        if (bus->device[address] == NULL)
+        {
+            bus = NULL;
+            goto out;
+        }
+
+        /* erased device without application info */
+        memset(bus->device[address], 0xFF, sizeof(struct sim_device));
+        bus->device[address]->write_status = WRITE_STATUS_OK;
+        bus->device[address]->busy_until = 0;
+        bus->device[address]->stretch_us = 0;
+        bus->device[address]->nak_us = 0;
+    }
+
+    bus->refcount++;
+
+out:
+    pthread_mutex_unlock(&sim_lock);
+    return bus;
+} /* sim_open */
+
+
+/* *************************************************************************
+ * sim_close
+ * ************************************************************************* */
+void sim_close(struct sim_bus *bus, uint8_t address)
+{
+    pthread_mutex_lock(&sim_lock);
+
+    if (--bus->refcount == 0)
+    {
+        int i;
+
+        for (i = 0; i < 128; i++)
+        {
+            free(bus->device[i]);
+            bus->device[i] = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&sim_lock);
+} /* sim_close */
+
+
+/* *************************************************************************
+ * sim_stats
+ * ************************************************************************* */
+int sim_stats(struct sim_bus *bus, uint8_t address, uint64_t *stretch_us, uint64_t *nak_us)
+{
+    struct sim_device *dev = bus->device[address & 0x7F];
+
+    if (dev == NULL)
+    {
+        return -1;
+    }
+
+    *stretch_us = dev->stretch_us;
+    *nak_us = dev->nak_us;
+    return 0;
+} /* sim_stats */
+
+
+/* *************************************************************************
+ * sim_read_page
+ * ************************************************************************* */
+static void sim_read_page(const struct sim_mcu *mcu, struct sim_device *dev,
+                          uint32_t address, uint8_t *page)
+{
+    if (address < mcu->flashsize)
+    {
+        memcpy(page, dev->flash + address, mcu->pagesize);
+    }
+    else
+    {
+        memset(page, 0xFF, mcu->pagesize);
+    }
+} /* sim_read_page */
+
+
+/* *************************************************************************
+ * sim_write_eeprom
+ * ************************************************************************* */
+static uint64_t sim_write_eeprom(const struct sim_mcu *mcu, struct sim_device *dev,
+                                 uint16_t address, uint8_t val)
+{
+    uint8_t old = dev->eeprom[address];
+
+    dev->eeprom[address] = val;
+
+    /* USE_EEPROM_UPDATE: unchanged bytes are skipped */
+    if (old == val)
+    {
+        return 0;
+    }
+
+    if (mcu->eepm && ((val == 0xFF) || ((old & val) == val)))
+    {
+        return SIM_EEPROM_SPLIT_US;
+    }
+
+    return SIM_EEPROM_WRITE_US;
+} /* sim_write_eeprom */
+
+
+/* *************************************************************************
+ * sim_invalidate_appinfo
+ * flash content changes, application info gets the invalid size 0x0000
+ * ************************************************************************* */
+static uint64_t sim_invalidate_appinfo(const struct sim_mcu *mcu, struct sim_device *dev)
+{
+    uint64_t busy_us = 0;
+    int i;
+
+    for (i = 0; i < SIM_APPINFO_SIZE_LEN(mcu); i++)
+    {
+        busy_us += sim_write_eeprom(mcu, dev, mcu->eepromsize - SIM_APPINFO_LEN(mcu) + i, 0x00);
+    }
+
+    return busy_us;
+} /* sim_invalidate_appinfo */
+
+
+/* *************************************************************************
+ * sim_write_page
+ * ************************************************************************* */
+static uint64_t sim_write_page(const struct sim_mcu *mcu, struct sim_device *dev,
+                               uint32_t address, const uint8_t *page, uint16_t size)
+{
+    uint64_t busy_us = SIM_FLASH_WRITE_US;
+
+    address &= ~(mcu->pagesize -1);
+    if (address < mcu->flashsize)
+    {
+        busy_us += sim_invalidate_appinfo(mcu, dev);
+        memset(dev->flash + address, 0xFF, mcu->pagesize);
+        memcpy(dev->flash + address, page, size);
+    }
+    else
+    {
+        dev->write_status |= WRITE_STATUS_ADDRESS_REJECTED;
+    }
+
+    return busy_us;
+} /* sim_write_page */
+
+
+
+/* *************************************************************************
+ * sim_header
+ * returns the header size of a CMD_ACCESS_MEMORY message
+ * ************************************************************************* */
+static int sim_header(const struct sim_mcu *mcu, const uint8_t *cmd, uint16_t size,
+                      uint8_t *memtype, uint32_t *address)
+{
+    int hdr;
+
+    if ((size < 4) || (cmd[0] != CMD_ACCESS_MEMORY))
+    {
+        return -1;
+    }
+
+    /* 3byte address variant is NAKed by devices with less than 64KiB flash */
+    if (cmd[1] & MEMTYPE_ADDR24)
+    {
+        if ((mcu->flashsize <= 0xFFFF) || (size < 5))
+        {
+            return -1;
+        }
+
+        *memtype = cmd[1] & ~MEMTYPE_ADDR24;
+        *address = (cmd[2] << 16) | (cmd[3] << 8) | cmd[4];
+        hdr = 5;
+    }
+    else
+    {
+        *memtype = cmd[1];
+        *address = (cmd[2] << 8) | cmd[3];
+        hdr = 4;
+    }
+
+    /* journal is stored in the eeprom before the application info */
+    if (*memtype == MEMTYPE_JOURNAL)
+    {
+        *memtype = MEMTYPE_EEPROM;
+        *address += mcu->eepromsize - SIM_APPINFO_LEN(mcu) -JOURNAL_LENGTH;
+    }
+
+    return hdr;
+} /* sim_header */
+
+
+/* *************************************************************************
+ * sim_write
+ * returns the write time within (clockstretching) and after the transfer (NAK)
+ * ************************************************************************* */
+static int sim_write(const struct sim_mcu *mcu, struct sim_device *dev,
+                     const uint8_t *data, uint16_t size,
+                     uint64_t *stretch_us, uint64_t *busy_us)
+{
+    uint8_t page[SIM_MAX_PAGESIZE];
+    uint32_t address;
+    uint16_t pos = 0;
+    uint8_t memtype;
+    uint16_t i;
+    int hdr;
+
+    if (size < 4)
+    {
+        /* CMD_WAIT, CMD_READ_VERSION, CMD_SWITCH_APPLICATION */
+        return ((size == 0) || (data[0] <= CMD_ACCESS_MEMORY)) ? 0 : -1;
+    }
+
+    hdr = sim_header(mcu, data, size, &memtype, &address);
+    if (hdr < 0)
+    {
+        return -1;
+    }
+
+    data += hdr;
+    size -= hdr;
+
+    switch (memtype)
+    {
+        case MEMTYPE_CHIPINFO:
+        case MEMTYPE_FLASH_CRC:
+        case MEMTYPE_WRITE_STATUS:
+            return 0;
+
+        case MEMTYPE_FLASH:
+            /* header of a read */
+            if (size == 0)
+            {
+                break;
+            }
+
+            /* PARTIAL_WRITE_SUPPORT: bytes not received keep their flash content */
+            pos = address % mcu->pagesize;
+            address -= pos;
+
+            for (i = 0; i < size; i++)
+            {
+                if ((pos == 0) || (i == 0))
+                {
+                    sim_read_page(mcu, dev, address, page);
+                }
+
+                page[pos++] = data[i];
+                if (pos == mcu->pagesize)
+                {
+                    /* next page is written with clockstretching */
+                    *stretch_us += *busy_us;
+                    *busy_us = sim_write_page(mcu, dev, address, page, pos);
+                    address += mcu->pagesize;
+                    pos = 0;
+                }
+            }
+
+            if (pos != 0)
+            {
+                *stretch_us += *busy_us;
+                *busy_us = sim_write_page(mcu, dev, address, page, mcu->pagesize);
+            }
+            break;
+
+        case MEMTYPE_FLASH_RLE:
+        {
+            uint8_t count = 0;
+
+            for (i = 0; (i < size) && (pos < mcu->pagesize); i++)
+            {
+                if (!(count & 0x7F))
+                {
+                    count = data[i];
+                    continue;
+                }
+
+                do {
+                    page[pos++] = data[i];
+                    count--;
+                } while ((count & 0x80) && (count & 0x7F) && (pos < mcu->pagesize));
+            }
+
+            /* remaining bytes are NAKed */
+            if (i < size)
+            {
+                return -1;
+            }
+
+            if (pos == mcu->pagesize)
+            {
+                *busy_us = sim_write_page(mcu, dev, address, page, pos);
+            }
+            else if (pos || (count & 0x7F))
+            {
+                /* ended within the page or a run: page is discarded */
+                dev->write_status |= WRITE_STATUS_INCOMPLETE;
+            }
+            break;
+        }
+
+        case MEMTYPE_PAGEBUF:
+            for (i = 0; i < size; i++)
+            {
+                dev->pagebuf[address++ % mcu->pagesize] = data[i];
+            }
+            break;
+
+        case MEMTYPE_PAGEBUF_COMMIT:
+            /* last address byte is NAKed, no data */
+            if (size != 0)
+            {
+                return -1;
+            }
+
+            *busy_us = sim_write_page(mcu, dev, address, dev->pagebuf, mcu->pagesize);
+            break;
+
+        case MEMTYPE_FLASH_ERASE:
+        {
+            /* ERASE_SUPPORT: page count 0 erases up to the bootloader section */
+            uint16_t count = (size >= 2) ? ((data[0] << 8) | data[1]) : 0;
+
+            if (size > 2)
+            {
+                return -1;
+            }
+
+            address &= ~(mcu->pagesize -1);
+            *busy_us = sim_invalidate_appinfo(mcu, dev);
+            do {
+                if (address >= mcu->flashsize)
+                {
+                    break;
+                }
+
+                memset(dev->flash + address, 0xFF, mcu->pagesize);
+                address += mcu->pagesize;
+                *busy_us += SIM_FLASH_ERASE_US;
+            } while (--count);
+            break;
+        }
+
+        case MEMTYPE_EEPROM:
+            for (i = 0; (i < size) && (address < mcu->eepromsize); i++)
+            {
+                *busy_us += sim_write_eeprom(mcu, dev, address++, data[i]);
+            }
+
+            if (i < size)
+            {
+                return -1;
+            }
+            break;
+
+        case MEMTYPE_APPINFO:
+        {
+            uint16_t info = mcu->eepromsize - SIM_APPINFO_LEN(mcu);
+            uint16_t journal = info -JOURNAL_LENGTH;
+            uint32_t app_size = 0;
+            uint16_t crc;
+
+            if ((size != 0) && (size != SIM_APPINFO_SIZE_LEN(mcu)))
+            {
+                return -1;
+            }
+
+            if (size == 0)
+            {
+                break;
+            }
+
+            for (i = 0; i < size; i++)
+            {
+                app_size = (app_size << 8) | data[i];
+            }
+
+            /* update not complete or size beyond bootloader: invalid size */
+            if ((memcmp(&dev->eeprom[journal +2], &dev->eeprom[journal +4], 2) != 0) ||
+                (app_size > mcu->flashsize)
+               )
+            {
+                app_size = 0x0000;
+            }
+
+            crc = twb_crc16(0xFFFF, dev->flash, app_size);
+
+            *busy_us = (app_size * SIM_CRC_BYTE_NS) / 1000;
+            for (i = 0; i < size; i++)
+            {
+                *busy_us += sim_write_eeprom(mcu, dev, info + i,
+                                             (app_size >> (8 * (size -1 -i))) & 0xFF);
+            }
+
+            *busy_us += sim_write_eeprom(mcu, dev, info + size, (crc >> 8) & 0xFF);
+            *busy_us += sim_write_eeprom(mcu, dev, info + size +1, crc & 0xFF);
+            break;
+        }
+
+        default:
+            return -1;
+    }
+
+    /* writes are done while SCL is stretched, the device never NAKs */
+    if (mcu->clockstretch)
+    {
+        *stretch_us += *busy_us;
+        *busy_us = 0;
+    }
+
+    return 0;
+} /* sim_write */
+
+
+/* *************************************************************************
+ * sim_read
+ * ************************************************************************* */
+static int sim_read(const struct sim_mcu *mcu, struct sim_device *dev,
+                    const uint8_t *cmd, uint16_t cmd_size,
+                    uint8_t *data, uint16_t size, uint64_t *stretch_us)
+{
+    uint32_t address;
+    uint16_t block;
+    uint16_t i;
+    uint8_t memtype;
+    int hdr;
+
+    if ((cmd_size == 1) && (cmd[0] == CMD_READ_VERSION))
+    {
+        memset(data, 0x00, size);
+        memcpy(data, SIM_VERSION, (size < sizeof(SIM_VERSION) -1) ? size : sizeof(SIM_VERSION) -1);
+        return 0;
+    }
+
+    hdr = sim_header(mcu, cmd, cmd_size, &memtype, &address);
+    if (hdr < 0)
+    {
+        return -1;
+    }
+
+    switch (memtype)
+    {
+        case MEMTYPE_CHIPINFO:
+        {
+            /* 9th byte only on devices with flash above 64KiB */
+            uint8_t chipinfo[9] = { mcu->signature[0], mcu->signature[1], mcu->signature[2],
+                                    mcu->pagesize & 0xFF,
+                                    (mcu->flashsize >> 8) & 0xFF, mcu->flashsize & 0xFF,
+                                    (mcu->eepromsize >> 8) & 0xFF, mcu->eepromsize & 0xFF,
+                                    (mcu->flashsize >> 16) & 0xFF
+                                  };
+            uint16_t len = (mcu->flashsize > 0xFFFF) ? 9 : 8;
+
+            for (i = 0; i < size; i++)
+            {
+                data[i] = (i < len) ? chipinfo[i] : 0xFF;
+            }
+            return 0;
+        }
+
+        case MEMTYPE_FLASH:
+            for (i = 0; i < size; i++, address++)
+            {
+                data[i] = (address < mcu->flashsize) ? dev->flash[address] : 0xFF;
+            }
+            return 0;
+
+        case MEMTYPE_FLASH_CRC:
+            block = (cmd_size >= hdr +2) ? ((cmd[hdr] << 8) | cmd[hdr +1]) : mcu->pagesize;
+
+            for (i = 0; i +1 < size; i += 2)
+            {
+                uint16_t crc = 0xFFFF;
+                uint16_t j;
+
+                for (j = 0; j < block; j++, address++)
+                {
+                    uint8_t val = (address < mcu->flashsize) ? dev->flash[address] : 0xFF;
+                    crc = twb_crc16(crc, &val, 1);
+                }
+
+                data[i] = (crc >> 8) & 0xFF;
+                data[i +1] = crc & 0xFF;
+                *stretch_us += (block * SIM_CRC_BYTE_NS) / 1000;
+            }
+            return 0;
+
+        case MEMTYPE_EEPROM:
+            for (i = 0; i < size; i++, address++)
+            {
+                data[i] = (address < mcu->eepromsize) ? dev->eeprom[address] : 0xFF;
+            }
+            return 0;
+
+        case MEMTYPE_APPINFO:
+            for (i = 0; i < size; i++)
+            {
+                data[i] = dev->eeprom[mcu->eepromsize - SIM_APPINFO_LEN(mcu) + (i % SIM_APPINFO_LEN(mcu))];
+            }
+            return 0;
+
+        case MEMTYPE_PAGEBUF:
+            for (i = 0; i < size; i++)
+            {
+                data[i] = dev->pagebuf[address++ % mcu->pagesize];
+            }
+            return 0;
+
+        case MEMTYPE_WRITE_STATUS:
+            memset(data, 0x00, size);
+            data[0] = dev->write_status;
+            dev->write_status = WRITE_STATUS_OK;
+            return 0;
+
+        default:
+            return -1;
+    }
+} /* sim_read */
+
+
+/* *************************************************************************
+ * sim_transfer
+ * ************************************************************************* */
+int sim_transfer(struct sim_bus *bus, uint8_t address,
+                 const uint8_t *wr_data, uint16_t wr_size,
+                 uint8_t *rd_data, uint16_t rd_size)
+{
+    uint64_t now = sim_time_us();
+    uint64_t stretch_us = 0;
+    uint64_t bus_us;
+    int i, acked = 0;
+
+    /* SLA, data and ACK bits (repeated start for the read part) */
+    bus_us = ((!!wr_size + wr_size + !!rd_size + rd_size) * 9 * 1000ULL) / bus->speed;
+
+    for (i = 0; i < 128; i++)
+    {
+        struct sim_device *dev = bus->device[i];
+        uint64_t dev_stretch_us = 0;
+        uint64_t busy_us = 0;
+
+        /* general call (0x00) is received by all devices, but is write only */
+        if ((dev == NULL) || ((i != address) && ((address != 0x00) || rd_size)))
+        {
+            continue;
+        }
+
+        /* write in progress: device does not acknowledge its address */
+        if (now < dev->busy_until)
+        {
+            dev->nak_us += (9 * 1000ULL) / bus->speed;
+            continue;
+        }
+
+        if ((wr_size && (sim_write(bus->mcu, dev, wr_data, wr_size, &dev_stretch_us, &busy_us) < 0)) ||
+            (rd_size && (sim_read(bus->mcu, dev, wr_data, wr_size, rd_data, rd_size, &dev_stretch_us) < 0))
+           )
+        {
+            sim_sleep_us(bus_us);
+            errno = EREMOTEIO;
+            return -1;
+        }
+
+        dev->busy_until = now + bus_us + dev_stretch_us + busy_us;
+        dev->stretch_us += dev_stretch_us;
+        acked = 1;
+
+        /* slowest device of a general call stretches the clock */
+        if (dev_stretch_us > stretch_us)
+        {
+            stretch_us = dev_stretch_us;
+        }
+    }
+
+    if (!acked)
+    {
+        /* address byte only */
+        sim_sleep_us((9 * 1000ULL) / bus->speed);
+        errno = ENXIO;
+        return -1;
+    }
+
+    sim_sleep_us(bus_us + stretch_us);
+    return 0;
+} /* sim_transfer */
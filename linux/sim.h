@@ -0,0 +1,42 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+
+/*
+ * simulated i2c bus with twiboot slaves (device name "sim:<mcu>[@<kHz>]")
+ * behavioral model of the protocol with assumed timing constants, it does
+ * not run the twiboot code (see native/bench.c). The host tool can be run
+ * without hardware. Unknown names are an atmega328p, default bus speed is
+ * 100kHz.
+ */
+struct sim_bus;
+
+struct sim_bus * sim_open(const char *name, uint8_t address);
+void sim_close(struct sim_bus *bus, uint8_t address);
+
+int sim_transfer(struct sim_bus *bus, uint8_t address,
+                 const uint8_t *wr_data, uint16_t wr_size,
+                 uint8_t *rd_data, uint16_t rd_size);
+
+int sim_stats(struct sim_bus *bus, uint8_t address, uint64_t *stretch_us, uint64_t *nak_us);
+
+#endif /* _SIM_H_ */
@@ -0,0 +1,761 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <termios.h>
+
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "twb.h"
+#include "sim.h"
+
+/* bootloader NAKs its address while a flash page / eeprom write is in progress */
+#define WRITE_POLL_INTERVAL_US  100
+#define WRITE_POLL_TIMEOUT_MS   100
+#define ERASE_POLL_TIMEOUT_MS   10000
+
+/* UART transport: bootloader replies after a write is done (also a flash erase) */
+#define UART_BAUDRATE           B500000
+#define UART_REPLY_TIMEOUT_MS   ERASE_POLL_TIMEOUT_MS
+
+/* *************************************************************************
+ * twb_crc16
+ * ************************************************************************* */
+uint16_t twb_crc16(uint16_t crc, const uint8_t *data, uint32_t size)
+{
+    /* same as avr-libc _crc_ccitt_update() */
+    while (size--)
+    {
+        uint8_t tmp = *data++ ^ (crc & 0xFF);
+        tmp ^= (tmp << 4);
+
+        crc = ((tmp << 8) | (crc >> 8)) ^ (tmp >> 4) ^ (tmp << 3);
+    }
+
+    return crc;
+} /* twb_crc16 */
+
+
+/* *************************************************************************
+ * twb_rle_encode
+ * ************************************************************************* */
+uint16_t twb_rle_encode(uint8_t *dst, const uint8_t *src, uint16_t size)
+{
+    uint16_t pos = 0;
+    uint16_t length = 0;
+
+    while (pos < size)
+    {
+        uint16_t count = 1;
+
+        while ((pos + count < size) && (src[pos + count] == src[pos]) && (count < 127))
+        {
+            count++;
+        }
+
+        if (count >= 3)
+        {
+            /* repeat run: 0x81-0xFF, value */
+            dst[length++] = 0x80 | count;
+            dst[length++] = src[pos];
+            pos += count;
+        }
+        else
+        {
+            /* literal run: 0x01-0x7F, data, up to the next repeat run */
+            uint16_t start = pos;
+
+            count = 0;
+            while ((pos < size) && (count < 127))
+            {
+                if ((pos +2 < size) &&
+                    (src[pos] == src[pos +1]) &&
+                    (src[pos] == src[pos +2])
+                   )
+                {
+                    break;
+                }
+
+                pos++;
+                count++;
+            }
+
+            dst[length++] = count;
+            memcpy(dst + length, src + start, count);
+            length += count;
+        }
+    }
+
+    return length;
+} /* twb_rle_encode */
+
+
+/* *************************************************************************
+ * twb_uart_read
+ * ************************************************************************* */
+static int twb_uart_read(struct twiboot *twb, uint8_t *data, uint16_t size)
+{
+    struct pollfd pfd = { .fd = twb->fd, .events = POLLIN };
+
+    while (size)
+    {
+        int len;
+
+        len = poll(&pfd, 1, UART_REPLY_TIMEOUT_MS);
+        if (len <= 0)
+        {
+            if (len == 0)
+            {
+                errno = ETIMEDOUT;
+            }
+            return -1;
+        }
+
+        len = read(twb->fd, data, size);
+        if (len <= 0)
+        {
+            return -1;
+        }
+
+        data += len;
+        size -= len;
+    }
+
+    return 0;
+} /* twb_uart_read */
+
+
+/* *************************************************************************
+ * twb_uart_transfer
+ * message frame: SLA+R/W, lenh, lenl, {data}
+ * ************************************************************************* */
+static int twb_uart_transfer(struct twiboot *twb,
+                             uint8_t *wr_data, uint16_t wr_size,
+                             uint8_t *rd_data, uint16_t rd_size)
+{
+    uint8_t frame[3];
+    uint8_t reply;
+
+    if (wr_size)
+    {
+        frame[0] = (twb->address << 1) | 0x00;
+        frame[1] = (wr_size >> 8) & 0xFF;
+        frame[2] = wr_size & 0xFF;
+
+        if ((write(twb->fd, frame, sizeof(frame)) != sizeof(frame)) ||
+            (write(twb->fd, wr_data, wr_size) != wr_size))
+        {
+            return -1;
+        }
+
+        /* no reply to a general call, devices are polled by address */
+        if (twb->gcall)
+        {
+            return tcdrain(twb->fd);
+        }
+
+        if (twb_uart_read(twb, &reply, 1) < 0)
+        {
+            return -1;
+        }
+
+        /* data was not accepted, same as a NAK on the i2c bus */
+        if (reply != UART_ACK)
+        {
+            errno = EREMOTEIO;
+            return -1;
+        }
+    }
+
+    if (rd_size)
+    {
+        frame[0] = (twb->address << 1) | 0x01;
+        frame[1] = (rd_size >> 8) & 0xFF;
+        frame[2] = rd_size & 0xFF;
+
+        if ((write(twb->fd, frame, sizeof(frame)) != sizeof(frame)) ||
+            (twb_uart_read(twb, rd_data, rd_size) < 0))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+} /* twb_uart_transfer */
+
+
+/* *************************************************************************
+ * twb_uart_open
+ * ************************************************************************* */
+static int twb_uart_open(struct twiboot *twb, const char *tty)
+{
+    struct termios tio;
+
+    twb->fd = open(tty, O_RDWR | O_NOCTTY);
+    if (twb->fd < 0)
+    {
+        return -1;
+    }
+
+    if (tcgetattr(twb->fd, &tio) < 0)
+    {
+        close(twb->fd);
+        return -1;
+    }
+
+    /* 8N1, no flow control */
+    cfmakeraw(&tio);
+    tio.c_cflag |= (CLOCAL | CREAD);
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    cfsetispeed(&tio, UART_BAUDRATE);
+    cfsetospeed(&tio, UART_BAUDRATE);
+
+    if (tcsetattr(twb->fd, TCSANOW, &tio) < 0)
+    {
+        close(twb->fd);
+        return -1;
+    }
+
+    tcflush(twb->fd, TCIOFLUSH);
+    twb->uart = 1;
+    return 0;
+} /* twb_uart_open */
+
+
+/* *************************************************************************
+ * twb_transfer
+ * ************************************************************************* */
+static int twb_transfer(struct twiboot *twb,
+                        uint8_t *wr_data, uint16_t wr_size,
+                        uint8_t *rd_data, uint16_t rd_size)
+{
+    struct i2c_msg msg[2];
+    struct i2c_rdwr_ioctl_data data;
+    int count = 0;
+
+    if (twb->sim != NULL)
+    {
+        /* simulated devices use the group address of the host */
+        return sim_transfer(twb->sim, twb->gcall ? 0x00 : twb->address,
+                            wr_data, wr_size, rd_data, rd_size);
+    }
+
+    if (twb->uart)
+    {
+        return twb_uart_transfer(twb, wr_data, wr_size, rd_data, rd_size);
+    }
+
+    if (wr_size)
+    {
+        msg[count].addr = twb->address;
+        msg[count].flags = 0;
+        msg[count].len = wr_size;
+        msg[count].buf = wr_data;
+        count++;
+    }
+
+    if (rd_size)
+    {
+        msg[count].addr = twb->address;
+        msg[count].flags = I2C_M_RD;
+        msg[count].len = rd_size;
+        msg[count].buf = rd_data;
+        count++;
+    }
+
+    data.msgs = msg;
+    data.nmsgs = count;
+
+    if (ioctl(twb->fd, I2C_RDWR, &data) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+} /* twb_transfer */
+
+
+/* *************************************************************************
+ * twb_header
+ * ************************************************************************* */
+static uint16_t twb_header(struct twiboot *twb, uint8_t *cmd, uint8_t memtype,
+                           uint32_t address)
+{
+    uint16_t len = 0;
+
+    cmd[len++] = CMD_ACCESS_MEMORY;
+
+    /* flash above 64KiB: address has an additional high byte */
+    if (twb->addr24)
+    {
+        cmd[len++] = memtype | MEMTYPE_ADDR24;
+        cmd[len++] = (address >> 16) & 0xFF;
+    }
+    else
+    {
+        cmd[len++] = memtype;
+    }
+
+    cmd[len++] = (address >> 8) & 0xFF;
+    cmd[len++] = address & 0xFF;
+
+    return len;
+} /* twb_header */
+
+
+/* *************************************************************************
+ * twb_read
+ * ************************************************************************* */
+int twb_read(struct twiboot *twb, uint8_t memtype, uint32_t address,
+             uint8_t *data, uint16_t size)
+{
+    while (size)
+    {
+        uint8_t cmd[5];
+        uint16_t hdr = twb_header(twb, cmd, memtype, address);
+        uint16_t len = size;
+
+        /* limited message size: continue at the next address */
+        if (twb->msg_size && (len > twb->msg_size))
+        {
+            len = twb->msg_size;
+        }
+
+        if (twb_transfer(twb, cmd, hdr, data, len) < 0)
+        {
+            fprintf(stderr, "twb_read(): failed to read at 0x%04x: %s\n",
+                    address, strerror(errno));
+            return -1;
+        }
+
+        address += len;
+        data += len;
+        size -= len;
+    }
+
+    return 0;
+} /* twb_read */
+
+
+/* *************************************************************************
+ * twb_write_poll
+ * ************************************************************************* */
+static int twb_write_poll(struct twiboot *twb, uint8_t *data, uint16_t size, int timeout_ms)
+{
+    int retry = (timeout_ms * 1000) / WRITE_POLL_INTERVAL_US;
+    struct timespec ts = { 0, WRITE_POLL_INTERVAL_US * 1000 };
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* retry until the previous write is completed */
+    while (twb_transfer(twb, data, size, NULL, 0) < 0)
+    {
+        if (((errno != ENXIO) && (errno != EREMOTEIO) && (errno != EIO)) || !retry--)
+        {
+            return -1;
+        }
+
+        twb->nak_count++;
+        nanosleep(&ts, NULL);
+
+        /* time until the device acknowledged, without the final transfer */
+        clock_gettime(CLOCK_MONOTONIC, &end);
+    }
+
+    if (retry != (timeout_ms * 1000) / WRITE_POLL_INTERVAL_US)
+    {
+        twb->nak_time += (end.tv_sec - start.tv_sec) * 1000000ULL +
+                         (end.tv_nsec - start.tv_nsec) / 1000;
+    }
+
+    return 0;
+} /* twb_write_poll */
+
+
+/* *************************************************************************
+ * twb_write_chunked
+ * ************************************************************************* */
+static int twb_write_chunked(struct twiboot *twb, uint32_t address,
+                             const uint8_t *data, uint16_t size)
+{
+    uint16_t chunk = twb->msg_size -4;
+    uint16_t pos, hdr;
+
+    /* assemble every page in the page buffer of the bootloader, then write it */
+    for (pos = 0; pos < size; pos += twb->pagesize)
+    {
+        uint8_t cmd[4 + chunk];
+        uint16_t offset;
+
+        for (offset = 0; offset < twb->pagesize; offset += chunk)
+        {
+            uint16_t len = twb->pagesize - offset;
+
+            if (len > chunk)
+            {
+                len = chunk;
+            }
+
+            cmd[0] = CMD_ACCESS_MEMORY;
+            cmd[1] = MEMTYPE_PAGEBUF;
+            cmd[2] = 0x00;
+            cmd[3] = offset;
+            memcpy(cmd +4, data + pos + offset, len);
+
+            /* the first message waits for the write of the previous page */
+            if (twb_write_poll(twb, cmd, 4 + len, WRITE_POLL_TIMEOUT_MS) < 0)
+            {
+                fprintf(stderr, "twb_write_chunked(): failed to write page buffer at 0x%04x: %s\n",
+                        address + pos + offset, strerror(errno));
+                return -1;
+            }
+        }
+
+        hdr = twb_header(twb, cmd, MEMTYPE_PAGEBUF_COMMIT, address + pos);
+
+        if (twb_transfer(twb, cmd, hdr, NULL, 0) < 0)
+        {
+            fprintf(stderr, "twb_write_chunked(): failed to write page at 0x%04x: %s\n",
+                    address + pos, strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+} /* twb_write_chunked */
+
+
+/* *************************************************************************
+ * twb_write
+ * ************************************************************************* */
+int twb_write(struct twiboot *twb, uint8_t memtype, uint32_t address,
+              const uint8_t *data, uint16_t size)
+{
+    uint8_t cmd[5 + size];
+    uint16_t hdr = twb_header(twb, cmd, memtype, address);
+
+    if ((memtype == MEMTYPE_FLASH) && twb->msg_size && (hdr + size > twb->msg_size))
+    {
+        return twb_write_chunked(twb, address, data, size);
+    }
+
+    memcpy(cmd + hdr, data, size);
+
+    if (twb_write_poll(twb, cmd, hdr + size, WRITE_POLL_TIMEOUT_MS) < 0)
+    {
+        fprintf(stderr, "twb_write(): failed to write at 0x%04x: %s\n",
+                address, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+} /* twb_write */
+
+
+/* *************************************************************************
+ * twb_sync
+ * ************************************************************************* */
+int twb_sync(struct twiboot *twb)
+{
+    uint8_t cmd = CMD_WAIT;
+
+    if (twb_write_poll(twb, &cmd, 1, WRITE_POLL_TIMEOUT_MS) < 0)
+    {
+        fprintf(stderr, "twb_sync(): bootloader not responding: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+} /* twb_sync */
+
+
+/* *************************************************************************
+ * twb_erase
+ * ************************************************************************* */
+int twb_erase(struct twiboot *twb, uint32_t address, uint16_t pages)
+{
+    uint8_t cmd[7];
+    uint16_t hdr = twb_header(twb, cmd, MEMTYPE_FLASH_ERASE, address);
+
+    /* without page count everything up to the bootloader section is erased */
+    if (pages)
+    {
+        cmd[hdr++] = (pages >> 8) & 0xFF;
+        cmd[hdr++] = pages & 0xFF;
+    }
+
+    if (twb_write_poll(twb, cmd, hdr, WRITE_POLL_TIMEOUT_MS) < 0)
+    {
+        fprintf(stderr, "twb_erase(): failed to erase at 0x%04x: %s\n",
+                address, strerror(errno));
+        return -1;
+    }
+
+    /* pages are erased after the Stop Condition, wait until done */
+    cmd[0] = CMD_WAIT;
+    if (twb_write_poll(twb, cmd, 1, ERASE_POLL_TIMEOUT_MS) < 0)
+    {
+        fprintf(stderr, "twb_erase(): bootloader not responding: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+} /* twb_erase */
+
+
+/* *************************************************************************
+ * twb_write_appinfo
+ * ************************************************************************* */
+int twb_write_appinfo(struct twiboot *twb, uint32_t size)
+{
+    uint8_t cmd[4];
+    uint8_t size_len = twb->addr24 ? 3 : 2;
+    uint8_t i;
+
+    /* size has 3 bytes above 64KiB flash */
+    for (i = 0; i < size_len; i++)
+    {
+        cmd[i] = (size >> (8 * (size_len -1 -i))) & 0xFF;
+    }
+
+    if (twb_write(twb, MEMTYPE_APPINFO, 0x0000, cmd, size_len) < 0)
+    {
+        return -1;
+    }
+
+    /* crc16 of the whole application is calculated after the Stop Condition, wait until done */
+    cmd[0] = CMD_WAIT;
+    if (twb_write_poll(twb, cmd, 1, ERASE_POLL_TIMEOUT_MS) < 0)
+    {
+        fprintf(stderr, "twb_write_appinfo(): bootloader not responding: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+} /* twb_write_appinfo */
+
+
+/* *************************************************************************
+ * twb_read_crc
+ * ************************************************************************* */
+int twb_read_crc(struct twiboot *twb, uint32_t address, uint16_t size, uint16_t *crc)
+{
+    uint8_t cmd[7];
+    uint16_t hdr = twb_header(twb, cmd, MEMTYPE_FLASH_CRC, address);
+    uint8_t result[2];
+
+    cmd[hdr++] = (size >> 8) & 0xFF;
+    cmd[hdr++] = size & 0xFF;
+
+    if (twb_transfer(twb, cmd, hdr, result, sizeof(result)) < 0)
+    {
+        fprintf(stderr, "twb_read_crc(): failed to read crc at 0x%04x: %s\n",
+                address, strerror(errno));
+        return -1;
+    }
+
+    *crc = (result[0] << 8) | result[1];
+    return 0;
+} /* twb_read_crc */
+
+
+/* *************************************************************************
+ * twb_read_page_crc
+ * ************************************************************************* */
+int twb_read_page_crc(struct twiboot *twb, uint32_t address, uint16_t *crc, uint16_t count)
+{
+    uint8_t cmd[5];
+    uint16_t hdr = twb_header(twb, cmd, MEMTYPE_FLASH_CRC, address);
+    uint8_t result[count * 2];
+    uint16_t i, len = count;
+
+    /* limited message size: continue at the next page */
+    if (twb->msg_size && (len > twb->msg_size / 2))
+    {
+        len = twb->msg_size / 2;
+    }
+
+    /* without size the bootloader returns one crc per flash page */
+    if (twb_transfer(twb, cmd, hdr, result, len * 2) < 0)
+    {
+        fprintf(stderr, "twb_read_page_crc(): failed to read crc at 0x%04x: %s\n",
+                address, strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        crc[i] = (result[i * 2] << 8) | result[i * 2 +1];
+    }
+
+    if (len < count)
+    {
+        return twb_read_page_crc(twb, address + len * twb->pagesize, crc + len, count - len);
+    }
+
+    return 0;
+} /* twb_read_page_crc */
+
+
+/* *************************************************************************
+ * twb_read_status
+ * ************************************************************************* */
+int twb_read_status(struct twiboot *twb, uint8_t *status)
+{
+    uint8_t cmd[4] = { CMD_ACCESS_MEMORY, MEMTYPE_WRITE_STATUS, 0x00, 0x00 };
+
+    /* status of the pages written since the last read, cleared on read */
+    if (twb_transfer(twb, cmd, sizeof(cmd), status, 1) < 0)
+    {
+        fprintf(stderr, "twb_read_status(): failed to read write status: %s\n",
+                strerror(errno));
+        return -1;
+    }
+
+    return 0;
+} /* twb_read_status */
+
+
+/* *************************************************************************
+ * twb_open
+ * ************************************************************************* */
+int twb_open(struct twiboot *twb, const char *device, uint8_t address, int warmboot)
+{
+    uint8_t cmd[5];
+    uint8_t chipinfo[TWB_CHIPINFO_LENGTH +1];
+
+    twb->device = device;
+    twb->address = address;
+    twb->gcall = 0;
+    twb->addr24 = 0;
+    twb->msg_size = 0;
+    twb->nak_count = 0;
+    twb->nak_time = 0;
+    twb->fd = -1;
+    twb->sim = NULL;
+    twb->uart = 0;
+
+    if (strncmp(device, "sim:", 4) == 0)
+    {
+        twb->sim = sim_open(device +4, address);
+        if (twb->sim == NULL)
+        {
+            fprintf(stderr, "failed to open '%s': %s\n", device, strerror(errno));
+            return -1;
+        }
+    }
+    else if (strncmp(device, "uart:", 5) == 0)
+    {
+        if (twb_uart_open(twb, device +5) < 0)
+        {
+            fprintf(stderr, "failed to open '%s': %s\n", device, strerror(errno));
+            return -1;
+        }
+    }
+    else
+    {
+        twb->fd = open(device, O_RDWR);
+        if (twb->fd < 0)
+        {
+            fprintf(stderr, "failed to open '%s': %s\n", device, strerror(errno));
+            return -1;
+        }
+    }
+
+    if (warmboot)
+    {
+        /* running application resets into the bootloader */
+        cmd[0] = CMD_SWITCH_APPLICATION;
+        cmd[1] = BOOTTYPE_BOOTLOADER;
+        if (twb_transfer(twb, cmd, 2, NULL, 0) < 0)
+        {
+            fprintf(stderr, "twb_open(): failed to switch to bootloader: %s\n", strerror(errno));
+            goto out_close;
+        }
+    }
+
+    /* abort boot timeout (device is not responding during the reset) */
+    cmd[0] = CMD_WAIT;
+    if (twb_write_poll(twb, cmd, 1, WRITE_POLL_TIMEOUT_MS) < 0)
+    {
+        fprintf(stderr, "twb_open(): failed to abort boot timeout: %s\n", strerror(errno));
+        goto out_close;
+    }
+
+    cmd[0] = CMD_READ_VERSION;
+    if (twb_transfer(twb, cmd, 1, (uint8_t *)twb->version, TWB_VERSION_LENGTH) < 0)
+    {
+        fprintf(stderr, "twb_open(): failed to read version: %s\n", strerror(errno));
+        goto out_close;
+    }
+
+    twb->version[TWB_VERSION_LENGTH] = '\0';
+
+    /* 3byte address variant is NAKed by devices with less than 64KiB flash */
+    twb->addr24 = 1;
+    twb_header(twb, cmd, MEMTYPE_CHIPINFO, 0x0000);
+    if (twb_transfer(twb, cmd, 5, chipinfo, sizeof(chipinfo)) < 0)
+    {
+        twb->addr24 = 0;
+        twb_header(twb, cmd, MEMTYPE_CHIPINFO, 0x0000);
+        if (twb_transfer(twb, cmd, 4, chipinfo, TWB_CHIPINFO_LENGTH) < 0)
+        {
+            fprintf(stderr, "twb_open(): failed to read chipinfo: %s\n", strerror(errno));
+            goto out_close;
+        }
+
+        chipinfo[TWB_CHIPINFO_LENGTH] = 0x00;
+    }
+
+    memcpy(twb->signature, chipinfo, sizeof(twb->signature));
+    twb->pagesize = chipinfo[3] ? chipinfo[3] : 256;
+    twb->flashsize = (chipinfo[8] << 16) | (chipinfo[4] << 8) | chipinfo[5];
+    twb->eepromsize = (chipinfo[6] << 8) | chipinfo[7];
+
+    return 0;
+
+out_close:
+    twb_close(twb);
+    return -1;
+} /* twb_open */
+
+
+/* *************************************************************************
+ * twb_close
+ * ************************************************************************* */
+void twb_close(struct twiboot *twb)
+{
+    if (twb->sim != NULL)
+    {
+        sim_close(twb->sim, twb->address);
+    }
+    else
+    {
+        close(twb->fd);
+    }
+} /* twb_close */
@@ -0,0 +1,76 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _TWB_H_
+#define _TWB_H_
+
+#include <stdint.h>
+
+#include "../twiboot.h"
+
+#define TWB_VERSION_LENGTH      16
+#define TWB_CHIPINFO_LENGTH     8
+
+/* CMD_ACCESS_MEMORY, memtype, [addrx,] addrh, addrl */
+#define TWB_HEADER_SIZE(twb)    ((twb)->addr24 ? 5 : 4)
+
+/* maximum size of a run length encoded block */
+#define TWB_RLE_MAXSIZE(x)      ((x) + ((x) + 126) / 127)
+
+struct sim_bus;
+
+struct twiboot {
+    const char *device;
+    int fd;
+    struct sim_bus *sim;    /* simulated bus ("sim:<bus>") instead of i2c-dev */
+    int uart;               /* UART transport ("uart:<tty>"), one page per message */
+    uint8_t address;
+    int gcall;              /* address is general call or group address: write only, no reply */
+
+    char version[TWB_VERSION_LENGTH +1];
+    uint8_t signature[3];
+    uint16_t pagesize;
+    uint32_t flashsize;
+    uint16_t eepromsize;
+    int addr24;             /* flash above 64KiB: 3byte address variant */
+
+    uint16_t msg_size;      /* max. bytes per i2c message, 0: unlimited (chunked page write) */
+
+    uint32_t nak_count;     /* address NAKs while polling for a write */
+    uint64_t nak_time;      /* time in us while polling for a write */
+};
+
+int twb_open(struct twiboot *twb, const char *device, uint8_t address, int warmboot);
+void twb_close(struct twiboot *twb);
+
+int twb_read(struct twiboot *twb, uint8_t memtype, uint32_t address,
+             uint8_t *data, uint16_t size);
+int twb_write(struct twiboot *twb, uint8_t memtype, uint32_t address,
+              const uint8_t *data, uint16_t size);
+int twb_sync(struct twiboot *twb);
+int twb_erase(struct twiboot *twb, uint32_t address, uint16_t pages);
+int twb_write_appinfo(struct twiboot *twb, uint32_t size);
+
+int twb_read_crc(struct twiboot *twb, uint32_t address, uint16_t size, uint16_t *crc);
+int twb_read_page_crc(struct twiboot *twb, uint32_t address, uint16_t *crc, uint16_t count);
+int twb_read_status(struct twiboot *twb, uint8_t *status);
+
+uint16_t twb_rle_encode(uint8_t *dst, const uint8_t *src, uint16_t size);
+uint16_t twb_crc16(uint16_t crc, const uint8_t *data, uint32_t size);
+
+#endif /* _TWB_H_ */
@@ -20,11 +20,70 @@
 #include <avr/interrupt.h>
 #include <avr/boot.h>
 #include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "twiboot.h"
 
 #define VERSION_STRING          "TWIBOOT v3.2"
 #define EEPROM_SUPPORT          1
 #define LED_SUPPORT             1
 
+#ifndef CRC_SUPPORT
+#define CRC_SUPPORT             0
+#endif
+
+#ifndef RLE_SUPPORT
+#define RLE_SUPPORT             0
+#endif
+
+#ifndef STREAM_SUPPORT
+#define STREAM_SUPPORT          0
+#endif
+
+#ifndef APPINFO_SUPPORT
+#define APPINFO_SUPPORT         0
+#endif
+
+#ifndef APPINFO_FULL_CHECK
+#define APPINFO_FULL_CHECK      1
+#endif
+
+#ifndef WARMBOOT_SUPPORT
+#define WARMBOOT_SUPPORT        0
+#endif
+
+#ifndef VERIFY_SUPPORT
+#define VERIFY_SUPPORT          0
+#endif
+
+#ifndef PARTIAL_WRITE_SUPPORT
+#define PARTIAL_WRITE_SUPPORT   0
+#endif
+
+#ifndef CHUNKED_WRITE_SUPPORT
+#define CHUNKED_WRITE_SUPPORT   0
+#endif
+
+#ifndef ERASE_SUPPORT
+#define ERASE_SUPPORT           0
+#endif
+
+#ifndef JOURNAL_SUPPORT
+#define JOURNAL_SUPPORT         0
+#endif
+
+#ifndef TRACE_SUPPORT
+#define TRACE_SUPPORT           0
+#endif
+
+#ifndef TRACE_ENTRIES
+#define TRACE_ENTRIES           16
+#endif
+
+#ifndef STATS_SUPPORT
+#define STATS_SUPPORT           0
+#endif
+
 #ifndef USE_CLOCKSTRETCH
 #define USE_CLOCKSTRETCH        0
 #endif
@@ -33,14 +92,51 @@
 #define VIRTUAL_BOOT_SECTION    0
 #endif
 
+#ifndef USE_PIPELINED_WRITE
+#define USE_PIPELINED_WRITE     0
+#endif
+
+#ifndef USE_EEPROM_UPDATE
+#define USE_EEPROM_UPDATE       0
+#endif
+
+#ifndef USE_PIPELINED_EEPROM
+#define USE_PIPELINED_EEPROM    0
+#endif
+
+#ifndef USE_UART
+#define USE_UART                0
+#endif
+
+#ifndef UART_BAUDRATE
+#define UART_BAUDRATE           500000
+#endif
+
 #ifndef TWI_ADDRESS
 #define TWI_ADDRESS             0x29
 #endif
 
+#ifndef TWI_GENERAL_CALL
+#define TWI_GENERAL_CALL        0
+#endif
+
+#ifndef TWI_GROUP_ADDRESS
+#define TWI_GROUP_ADDRESS       0x00
+#endif
+
+#ifndef ADDRESS_EEPROM_SUPPORT
+#define ADDRESS_EEPROM_SUPPORT  0
+#endif
+
+#ifndef ADDRESS_STRAP_SUPPORT
+#define ADDRESS_STRAP_SUPPORT   0
+#endif
+
 #define F_CPU                   8000000ULL
 #define TIMER_DIVISOR           1024
 #define TIMER_IRQFREQ_MS        25
 #define TIMEOUT_MS              1000
+#define FASTBOOT_TIMEOUT_MS     5
 
 #define TIMER_MSEC2TICKS(x)     ((x * F_CPU) / (TIMER_DIVISOR * 1000ULL))
 #define TIMER_MSEC2IRQCNT(x)    (x / TIMER_IRQFREQ_MS)
@@ -63,17 +159,14 @@
 #define LED_OFF()
 #endif /* LED_SUPPORT */
 
-#if !defined(TWCR) && defined(USICR)
+#if (USE_UART == 0) && !defined(TWCR) && defined(USICR)
 #define USI_PIN_INIT()          { PORTB |= ((1<<PORTB0) | (1<<PORTB2)); \
                                   DDRB |= (1<<PORTB2); \
                                 }
 #define USI_PIN_SDA_INPUT()     DDRB &= ~(1<<PORTB0)
 #define USI_PIN_SDA_OUTPUT()    DDRB |= (1<<PORTB0)
 #define USI_PIN_SCL()           (PINB & (1<<PINB2))
-
-#if (USE_CLOCKSTRETCH == 0)
-#error "USI peripheral requires enabled USE_CLOCKSTRETCH"
-#endif
+#define USI_PIN_RELEASE()       DDRB &= ~((1<<PORTB0) | (1<<PORTB2))
 
 #define USI_STATE_MASK          0x0F
 #define USI_STATE_IDLE          0x00    /* wait for Start Condition */
@@ -88,7 +181,128 @@
 #define USI_WAIT_FOR_ACK        0x10    /* wait for ACK bit (2 SCL clock edges) */
 #define USI_ENABLE_SDA_OUTPUT   0x20    /* SDA is output (slave transmitting) */
 #define USI_ENABLE_SCL_HOLD     0x40    /* Hold SCL low after clock overflow */
-#endif /* !defined(TWCR) && defined(USICR) */
+#endif /* (USE_UART == 0) && !defined(TWCR) && defined(USICR) */
+
+#if (USE_UART)
+#if defined (UDR0)
+#define UART_UDR                UDR0
+#define UART_UCSRA              UCSR0A
+#define UART_UCSRB              UCSR0B
+#define UART_UBRRH              UBRR0H
+#define UART_UBRRL              UBRR0L
+#define UART_RXC                RXC0
+#define UART_TXC                TXC0
+#define UART_UDRE               UDRE0
+#define UART_U2X                U2X0
+#define UART_RXEN               RXEN0
+#define UART_TXEN               TXEN0
+#elif defined (UDR)
+#define UART_UDR                UDR
+#define UART_UCSRA              UCSRA
+#define UART_UCSRB              UCSRB
+#define UART_UBRRH              UBRRH
+#define UART_UBRRL              UBRRL
+#define UART_RXC                RXC
+#define UART_TXC                TXC
+#define UART_UDRE               UDRE
+#define UART_U2X                U2X
+#define UART_RXEN               RXEN
+#define UART_TXEN               TXEN
+#else
+#error "USE_UART requires a device with UART"
+#endif
+
+/* double speed mode, 8N1 */
+#define UART_UBRR_VALUE         ((F_CPU / 8 + UART_BAUDRATE / 2) / UART_BAUDRATE -1)
+
+#define UART_STATE_SLA          0x00    /* wait for Slave Address */
+#define UART_STATE_LENH         0x01    /* wait for message length */
+#define UART_STATE_LENL         0x02
+#define UART_STATE_DATW         0x03    /* receive Data */
+#define UART_STATE_SKIP         0x04    /* not addressed, skip Data */
+#define UART_TIMEOUT            0x80    /* no byte received for one timer period */
+#endif /* (USE_UART) */
+
+/* application info (2byte size, 2byte crc) in the last EEPROM bytes (used or not),
+ * devices with flash above 64KiB use a 3byte size
+ */
+#define APPINFO_SIZE_LENGTH     (2 + FLASH_ADDR24)
+#define APPINFO_LENGTH          (APPINFO_SIZE_LENGTH + 2)
+
+#if (APPINFO_SUPPORT)
+#if (EEPROM_SUPPORT == 0)
+#error "APPINFO_SUPPORT requires EEPROM_SUPPORT"
+#endif
+
+#define APPINFO_EEPROM_ADDR     (E2END +1 -APPINFO_LENGTH)
+#define APPINFO_SIZE_ERASED     ((1UL << (8 * APPINFO_SIZE_LENGTH)) -1)
+#endif /* (APPINFO_SUPPORT) */
+
+#if (JOURNAL_SUPPORT)
+#if (EEPROM_SUPPORT == 0)
+#error "JOURNAL_SUPPORT requires EEPROM_SUPPORT"
+#endif
+
+/* update journal in the EEPROM bytes before the application info */
+#define JOURNAL_EEPROM_ADDR     (E2END +1 -APPINFO_LENGTH -JOURNAL_LENGTH)
+#endif /* (JOURNAL_SUPPORT) */
+
+#if (ADDRESS_EEPROM_SUPPORT)
+#if (EEPROM_SUPPORT == 0)
+#error "ADDRESS_EEPROM_SUPPORT requires EEPROM_SUPPORT"
+#endif
+
+/* slave address in the EEPROM byte before the update journal (used or not) */
+#define ADDRESS_EEPROM_ADDR     (E2END +1 -APPINFO_LENGTH -JOURNAL_LENGTH -1)
+#endif /* (ADDRESS_EEPROM_SUPPORT) */
+
+#if (ADDRESS_STRAP_SUPPORT)
+/* PB1 / PB3 with pullups, a pin tied to GND adds 1 / 2 to the slave address */
+#define ADDRESS_STRAP_INIT()    PORTB |= ((1<<PORTB1) | (1<<PORTB3))
+#define ADDRESS_STRAP_READ()    (((~PINB >> PINB1) & 0x01) | ((~PINB >> (PINB3 -1)) & 0x02))
+#define ADDRESS_STRAP_OFF()     PORTB &= ~((1<<PORTB1) | (1<<PORTB3))
+#endif /* (ADDRESS_STRAP_SUPPORT) */
+
+#if (TRACE_SUPPORT)
+#if (TRACE_ENTRIES > 64)
+#error "TRACE_ENTRIES must not exceed 64"
+#endif
+
+#if (TIMER_MSEC2TICKS(TIMER_IRQFREQ_MS) != TRACE_TICKS_PER_OVF)
+#error "TRACE_TICKS_PER_OVF does not match the timer period"
+#endif
+
+#define TRACE(x)                trace_event(x)
+#else
+#define TRACE(x)
+#endif /* (TRACE_SUPPORT) */
+
+#if (STATS_SUPPORT)
+#define STATS_ADD(x, size, val) stats_add((x), (size), (val))
+#else
+#define STATS_ADD(x, size, val)
+#endif /* (STATS_SUPPORT) */
+
+/* 2byte counters of the statistics block */
+#define STATS_INC(x)            STATS_ADD((x), 2, 1)
+
+#if (ADDRESS_EEPROM_SUPPORT) || (ADDRESS_STRAP_SUPPORT)
+/* slave address (SLA+W) is determined at startup */
+#define TWI_SLA                 twi_sla
+#else
+#define TWI_SLA                 (TWI_ADDRESS<<1)
+#endif
+
+/* write only address shared by all devices: general call (0x00) or group address */
+#define TWI_GCALL_SLA           (TWI_GROUP_ADDRESS<<1)
+
+#if (TWI_GROUP_ADDRESS != 0x00) && (TWI_GENERAL_CALL == 0)
+#error "TWI_GROUP_ADDRESS requires TWI_GENERAL_CALL"
+#endif
+
+#if (TWI_GROUP_ADDRESS != 0x00) && (USE_UART == 0) && defined (TWCR) && !defined (TWAMR)
+#error "TWI_GROUP_ADDRESS requires a TWI with address mask (TWAMR)"
+#endif
 
 #if (VIRTUAL_BOOT_SECTION)
 /* unused vector to store application start address */
@@ -103,102 +317,739 @@
 /* create RJMP opcode for the vector table */
 #define OPCODE_RJMP(addr)       (((addr) & 0x0FFF) | 0xC000)
 
+#if (USE_PIPELINED_WRITE)
+#error "USE_PIPELINED_WRITE requires a device with bootloader section"
+#endif
+
 #elif (!defined(ASRE) && !defined (RWWSRE))
 #error "Device without bootloader section requires VIRTUAL_BOOT_SECTION"
 #endif
 
-/* SLA+R */
-#define CMD_WAIT                0x00
-#define CMD_READ_VERSION        0x01
-#define CMD_ACCESS_MEMORY       0x02
-/* internal mappings */
+#if (USE_PIPELINED_EEPROM) && (EEPROM_SUPPORT == 0)
+#error "USE_PIPELINED_EEPROM requires EEPROM_SUPPORT"
+#endif
+
+#if (VERIFY_SUPPORT) && (USE_PIPELINED_WRITE)
+#error "VERIFY_SUPPORT can not be used with USE_PIPELINED_WRITE"
+#endif
+
+#if (STREAM_SUPPORT) && ((USE_CLOCKSTRETCH == 0) || (USE_UART))
+#error "STREAM_SUPPORT requires USE_CLOCKSTRETCH and TWI/USI"
+#endif
+
+#if (FLASHEND > 0xFFFF)
+/* flash above 64KiB: 3byte addresses, far reads, RAMPZ aware SPM (avr/boot.h) */
+#define FLASH_ADDR24            1
+#define FLASH_READ_BYTE(x)      pgm_read_byte_far(x)
+typedef uint32_t address_t;
+#else
+#define FLASH_ADDR24            0
+#define FLASH_READ_BYTE(x)      pgm_read_byte_near(x)
+typedef uint16_t address_t;
+#endif /* (FLASHEND > 0xFFFF) */
+
+/* offset within a page / page buffer */
+#if (SPM_PAGESIZE > 0xFF)
+typedef uint16_t pagepos_t;
+#else
+typedef uint8_t pagepos_t;
+#endif
+
+/* write messages above 255 bytes (streaming, clockstretched eeprom, chunks, 256 bytes/page):
+ * the byte counter stops at 0xFF instead of restarting with the header
+ */
+#if (USE_CLOCKSTRETCH) || (CHUNKED_WRITE_SUPPORT) || (SPM_PAGESIZE > (0xFF -5))
+#define BCNT_SATURATE           1
+#else
+#define BCNT_SATURATE           0
+#endif
+
+#if (USE_PIPELINED_WRITE)
+#define SPM_STATE_IDLE          0x00    /* no flash operation in progress */
+#define SPM_STATE_ERASE         0x01    /* page erase in progress */
+#define SPM_STATE_WRITE         0x02    /* page write in progress */
+#endif /* (USE_PIPELINED_WRITE) */
+
+/* SLA+R internal mappings */
 #define CMD_ACCESS_CHIPINFO     (0x10 | CMD_ACCESS_MEMORY)
 #define CMD_ACCESS_FLASH        (0x20 | CMD_ACCESS_MEMORY)
 #define CMD_ACCESS_EEPROM       (0x30 | CMD_ACCESS_MEMORY)
 #define CMD_WRITE_FLASH_PAGE    (0x40 | CMD_ACCESS_MEMORY)
 #define CMD_WRITE_EEPROM_PAGE   (0x50 | CMD_ACCESS_MEMORY)
+#define CMD_ACCESS_FLASH_CRC    (0x60 | CMD_ACCESS_MEMORY)
+#define CMD_WRITE_FLASH_RLE     (0x70 | CMD_ACCESS_MEMORY)
+#define CMD_ACCESS_APPINFO      (0x80 | CMD_ACCESS_MEMORY)
+#define CMD_WRITE_APPINFO       (0x90 | CMD_ACCESS_MEMORY)
+#define CMD_ACCESS_STATUS       (0xA0 | CMD_ACCESS_MEMORY)
+#define CMD_ACCESS_PAGEBUF      (0xB0 | CMD_ACCESS_MEMORY)
+#define CMD_COMMIT_PAGEBUF      (0xC0 | CMD_ACCESS_MEMORY)
+#define CMD_ERASE_FLASH         (0xD0 | CMD_ACCESS_MEMORY)
+#define CMD_ACCESS_JOURNAL      (0xE0 | CMD_ACCESS_MEMORY)
+#define CMD_ACCESS_TRACE        (0xF0 | CMD_ACCESS_MEMORY)
+
+/* SLA+R internal mappings, all 0x?2 values are in use */
+#define CMD_ACCESS_STATS        (0x10 | CMD_ACCESS_MEMORY | 0x01)
+
+/* SLA+W internal mappings */
+#define CMD_BOOT_BOOTLOADER     (0x10 | CMD_SWITCH_APPLICATION) /* only in APP */
+#define CMD_BOOT_APPLICATION    (0x20 | CMD_SWITCH_APPLICATION)
+
+/*
+ * LED_GN flashes with 20Hz (while bootloader is running)
+ * LED_RT flashes on TWI activity
+ *
+ * bootloader twi-protocol:
+ * - abort boot timeout:
+ *   SLA+W, 0x00, STO
+ *
+ * - show bootloader version
+ *   SLA+W, 0x01, SLA+R, {16 bytes}, STO
+ *
+ * - start application
+ *   SLA+W, 0x01, 0x80, STO
+ *
+ * - read chip info: 3byte signature, 1byte page size, 2byte flash size, 2byte eeprom size
+ *   SLA+W, 0x02, 0x00, 0x00, 0x00, SLA+R, {8 bytes}, STO
+ *   page size 256 is reported as 0x00
+ *
+ * - 3byte address variant (flash above 64KiB): memtype | 0x80, addrx before addrh
+ *   SLA+W, 0x02, 0x80 | memtype, addrx, addrh, addrl, {...}
+ *   chip info has a 9th byte: flash size bits 16-23
+ *   not supported (NAK) by devices with less than 64KiB flash
+ *
+ * - read one (or more) flash bytes
+ *   SLA+W, 0x02, 0x01, addrh, addrl, SLA+R, {* bytes}, STO
+ *
+ * - read one (or more) eeprom bytes
+ *   SLA+W, 0x02, 0x02, addrh, addrl, SLA+R, {* bytes}, STO
+ *
+ * - read crc16 of one (or more) flash pages: 2byte crc (msb first) per page
+ *   SLA+W, 0x02, 0x03, addrh, addrl, SLA+R, {2 bytes per page}, STO
+ *
+ * - read crc16 of one (or more) flash blocks with given size
+ *   SLA+W, 0x02, 0x03, addrh, addrl, sizeh, sizel, SLA+R, {2 bytes per block}, STO
+ *
+ * - write one (or more) flash pages
+ *   SLA+W, 0x02, 0x01, addrh, addrl, {* bytes}, STO
+ *   with PARTIAL_WRITE_SUPPORT any address / length, bytes not received keep their content
+ *
+ * - write one (or more) eeprom bytes
+ *   SLA+W, 0x02, 0x02, addrh, addrl, {* bytes}, STO
+ *
+ * - read application info: 2byte size (3byte above 64KiB flash), 2byte crc16
+ *   SLA+W, 0x02, 0x05, 0x00, 0x00, SLA+R, {4 bytes}, STO
+ *
+ * - write application info: bootloader calculates crc16 of flash (0x0000 - size)
+ *   SLA+W, 0x02, 0x05, 0x00, 0x00, sizeh, sizel, STO
+ *   SLA+W, 0x02, 0x05, 0x00, 0x00, sizex, sizeh, sizel, STO (above 64KiB flash)
+ *
+ * - write one flash page, run length encoded
+ *   SLA+W, 0x02, 0x04, addrh, addrl, {* bytes}, STO
+ *   0x01-0x7F: copy the next 1-127 bytes
+ *   0x81-0xFF: repeat the next byte 1-127 times
+ *
+ * - read write status of the flash pages written since the last read
+ *   SLA+W, 0x02, 0x06, 0x00, 0x00, SLA+R, {1 byte}, STO
+ *
+ * - write / read page buffer (offset within the page)
+ *   SLA+W, 0x02, 0x07, addrh, addrl, {* bytes}, STO
+ *   SLA+W, 0x02, 0x07, addrh, addrl, SLA+R, {* bytes}, STO
+ *
+ * - write page buffer to flash page
+ *   SLA+W, 0x02, 0x08, addrh, addrl, STO
+ *
+ * - erase flash pages up to the bootloader section (optional: number of pages)
+ *   SLA+W, 0x02, 0x09, addrh, addrl, {counth, countl}, STO
+ *
+ * - read / write update journal: 2byte image id, 2byte page count, 2byte committed pages
+ *   SLA+W, 0x02, 0x0A, 0x00, offset, SLA+R, {* bytes}, STO
+ *   SLA+W, 0x02, 0x0A, 0x00, offset, {* bytes}, STO
+ *
+ * - read event trace: 4byte entries (event, 2byte timer overflows, TCNT0), oldest first
+ *   SLA+W, 0x02, 0x0B, 0x00, offset, SLA+R, {* bytes}, STO
+ *   bytes after the last entry read as 0x00
+ *
+ * - read statistics: reset cause, counters since bootloader start (msb first)
+ *   SLA+W, 0x02, 0x0C, 0x00, 0x00, SLA+R, {13 bytes}, STO
+ */
+
+static const uint8_t info[16] = VERSION_STRING;
+static const uint8_t chipinfo[] = {
+    SIGNATURE_0, SIGNATURE_1, SIGNATURE_2,
+    (SPM_PAGESIZE & 0xFF),
+
+    (BOOTLOADER_START >> 8) & 0xFF,
+    BOOTLOADER_START & 0xFF,
+
+#if (EEPROM_SUPPORT)
+    ((E2END +1) >> 8 & 0xFF),
+    (E2END +1) & 0xFF,
+#else
+    0x00, 0x00,
+#endif
+
+#if (FLASH_ADDR24)
+    (BOOTLOADER_START >> 16) & 0xFF,
+#endif
+};
+
+static uint8_t boot_timeout = TIMER_MSEC2IRQCNT(TIMEOUT_MS);
+static uint8_t cmd = CMD_WAIT;
+
+#if (TWI_GENERAL_CALL)
+/* current write was received on the general call address */
+static uint8_t gcall;
+#endif /* (TWI_GENERAL_CALL) */
+
+/* flash buffer */
+static uint8_t buf[SPM_PAGESIZE];
+static pagepos_t pos;
+static address_t addr;
+
+#if (FLASH_ADDR24)
+/* current message uses the 3byte address variant */
+static uint8_t addr24;
+#endif
+
+#if (VIRTUAL_BOOT_SECTION)
+/* reset/application vectors received from host, needed for verify read */
+static uint8_t rstvect_save[2];
+static uint8_t appvect_save[2];
+#endif /* (VIRTUAL_BOOT_SECTION) */
+
+#if (CRC_SUPPORT)
+static uint16_t crc;
+static uint16_t crc_size;
+#endif /* (CRC_SUPPORT) */
+
+#if (ERASE_SUPPORT)
+/* number of pages to erase, 0: up to the bootloader section */
+static uint16_t erase_count;
+#endif /* (ERASE_SUPPORT) */
+
+#if (RLE_SUPPORT)
+/* decoder state: remaining bytes of current run */
+static uint8_t rle_count;
+#endif /* (RLE_SUPPORT) */
+
+#if (VERIFY_SUPPORT)
+/* WRITE_STATUS_* bits, cleared on read */
+static uint8_t write_status;
+#endif /* (VERIFY_SUPPORT) */
+
+#if (USE_PIPELINED_EEPROM)
+/* eeprom write ring in buf: bytes not yet written start at buf[ee_tail] / addr */
+static pagepos_t ee_tail;
+static pagepos_t ee_count;
+
+#if (USE_UART == 0) && defined (TWCR) && (USE_CLOCKSTRETCH == 0)
+/* own address is NAKed until the ring is written */
+static uint8_t ee_nak;
+#endif
+#endif /* (USE_PIPELINED_EEPROM) */
+
+#if (USE_UART)
+/* UART message state, reset by the timer within an incomplete message */
+static uint8_t uart_state;
+#endif /* (USE_UART) */
+
+#if (ADDRESS_EEPROM_SUPPORT) || (ADDRESS_STRAP_SUPPORT)
+/* own slave address (SLA+W) */
+static uint8_t twi_sla;
+#endif
+
+#if (TRACE_SUPPORT)
+/* event ring, trace_head is the byte offset of the oldest entry */
+static uint8_t trace_buf[TRACE_ENTRIES * TRACE_ENTRY_SIZE];
+static uint8_t trace_head;
+static uint16_t trace_ovf;
+
+
+/* *************************************************************************
+ * trace_event
+ * ************************************************************************* */
+static void trace_event(uint8_t event)
+{
+    uint8_t *p = &trace_buf[trace_head];
+
+    /* reading the trace does not overwrite it */
+    if (cmd == CMD_ACCESS_TRACE)
+    {
+        return;
+    }
+
+    p[0] = event;
+    p[1] = (trace_ovf >> 8);
+    p[2] = (trace_ovf & 0xFF);
+    p[3] = TCNT0;
+
+    trace_head = (trace_head + TRACE_ENTRY_SIZE) % sizeof(trace_buf);
+} /* trace_event */
+#endif /* (TRACE_SUPPORT) */
+
+#if (STATS_SUPPORT)
+/* STATS_* counters, msb first */
+static uint8_t stats[STATS_LENGTH];
+
+
+/* *************************************************************************
+ * stats_add
+ * ************************************************************************* */
+static void stats_add(uint8_t offset, uint8_t size, uint8_t val)
+{
+    uint8_t *p = &stats[offset + size];
+
+    /* add to the lsb, carry into the upper bytes of the counter */
+    do {
+        uint8_t old = *--p;
+
+        *p = old + val;
+        val = (*p < old);
+    } while (val && --size);
+} /* stats_add */
+#endif /* (STATS_SUPPORT) */
+
+#if (USE_PIPELINED_WRITE)
+/* page erase/write running in the RWW section while receiving the next page */
+static uint8_t spm_state;
+static address_t spm_pagestart;
+
+#if (STATS_SUPPORT)
+/* TCNT0 at the start of the page erase */
+static uint8_t spm_ticks;
+#endif
+
+
+/* *************************************************************************
+ * flash_poll
+ * ************************************************************************* */
+static void flash_poll(void)
+{
+    if ((spm_state != SPM_STATE_IDLE) && !boot_spm_busy())
+    {
+        if (spm_state == SPM_STATE_ERASE)
+        {
+            boot_page_write(spm_pagestart);
+            spm_state = SPM_STATE_WRITE;
+        }
+        else
+        {
+            boot_rww_enable();
+            spm_state = SPM_STATE_IDLE;
+            TRACE(TRACE_COMMIT_END);
+            STATS_ADD(STATS_SPM_TICKS, 4, (uint8_t)(TCNT0 - spm_ticks));
+        }
+    }
+} /* flash_poll */
+
+
+/* *************************************************************************
+ * flash_sync
+ * ************************************************************************* */
+static void flash_sync(void)
+{
+    while (spm_state != SPM_STATE_IDLE)
+    {
+        flash_poll();
+    }
+} /* flash_sync */
+#endif /* (USE_PIPELINED_WRITE) */
+
+
+#if (VIRTUAL_BOOT_SECTION)
+/* *************************************************************************
+ * read_vectors
+ * ************************************************************************* */
+static void read_vectors(void)
+{
+    /* load current values (for reading flash) */
+    rstvect_save[0] = pgm_read_byte_near(RSTVECT_ADDR);
+    rstvect_save[1] = pgm_read_byte_near(RSTVECT_ADDR + 1);
+    appvect_save[0] = pgm_read_byte_near(APPVECT_ADDR);
+    appvect_save[1] = pgm_read_byte_near(APPVECT_ADDR + 1);
+
+    /* patched by write_flash_page(): original reset vector is the target of the application vector */
+    if ((rstvect_save[0] | (rstvect_save[1] << 8)) == OPCODE_RJMP(BOOTLOADER_START -1))
+    {
+        uint16_t rst_vector = appvect_save[0] | (appvect_save[1] << 8);
+        rst_vector = OPCODE_RJMP(rst_vector + APPVECT_NUM);
+
+        rstvect_save[0] = (rst_vector & 0xFF);
+        rstvect_save[1] = (rst_vector >> 8) & 0xFF;
+    }
+} /* read_vectors */
+#endif /* (VIRTUAL_BOOT_SECTION) */
+
+
+/* *************************************************************************
+ * read_flash_byte
+ * ************************************************************************* */
+static uint8_t read_flash_byte(address_t address)
+{
+    uint8_t data;
+
+#if (USE_PIPELINED_WRITE)
+    /* RWW section is not readable while a page write is in progress */
+    flash_sync();
+#endif
+
+    switch (address)
+    {
+/* return cached values for verify read */
+#if (VIRTUAL_BOOT_SECTION)
+        case RSTVECT_ADDR:
+            data = rstvect_save[0];
+            break;
+
+        case (RSTVECT_ADDR + 1):
+            data = rstvect_save[1];
+            break;
+
+        case APPVECT_ADDR:
+            data = appvect_save[0];
+            break;
+
+        case (APPVECT_ADDR + 1):
+            data = appvect_save[1];
+            break;
+#endif /* (VIRTUAL_BOOT_SECTION) */
+
+        default:
+            data = FLASH_READ_BYTE(address);
+            break;
+    }
+
+    return data;
+} /* read_flash_byte */
+
+
+#if (PARTIAL_WRITE_SUPPORT)
+/* *************************************************************************
+ * read_flash_page
+ * ************************************************************************* */
+static void read_flash_page(pagepos_t start, pagepos_t end)
+{
+    /* current flash content (incl. cached vectors) for read-modify-write */
+    while (start < end)
+    {
+        buf[start] = read_flash_byte(addr + start);
+        start++;
+    }
+} /* read_flash_page */
+#endif /* (PARTIAL_WRITE_SUPPORT) */
+
+
+#if (CRC_SUPPORT)
+/* *************************************************************************
+ * read_flash_crc
+ * ************************************************************************* */
+static uint16_t read_flash_crc(uint16_t size)
+{
+    uint16_t result = 0xFFFF;
+
+    while (size--)
+    {
+        result = _crc_ccitt_update(result, read_flash_byte(addr++));
+    }
+
+    return result;
+} /* read_flash_crc */
+#endif /* (CRC_SUPPORT) */
+
+
+#if (VERIFY_SUPPORT)
+/* *************************************************************************
+ * verify_flash_page
+ * ************************************************************************* */
+static void verify_flash_page(address_t pagestart)
+{
+    pagepos_t size = SPM_PAGESIZE;
+    uint8_t *p = buf;
+
+    /* buf contains the patched vectors, compare with real flash content */
+    do {
+        if (FLASH_READ_BYTE(pagestart++) != *p++)
+        {
+            write_status |= WRITE_STATUS_VERIFY_FAILED;
+            break;
+        }
+    } while (--size);
+} /* verify_flash_page */
+#endif /* (VERIFY_SUPPORT) */
+
+
+#if (EEPROM_SUPPORT)
+/* *************************************************************************
+ * read_eeprom_byte
+ * ************************************************************************* */
+static uint8_t read_eeprom_byte(uint16_t address)
+{
+#if (USE_PIPELINED_EEPROM)
+    /* previous write may still be in progress */
+    eeprom_busy_wait();
+#endif
+
+    EEARL = address;
+    EEARH = (address >> 8);
+    EECR |= (1<<EERE);
+
+    return EEDR;
+} /* read_eeprom_byte */
+
+
+/* *************************************************************************
+ * write_eeprom_byte
+ * ************************************************************************* */
+static void write_eeprom_byte(uint8_t val)
+{
+#if (USE_PIPELINED_WRITE)
+    /* EEPROM write is not possible while SPM is active */
+    flash_sync();
+#endif
+
+#if (USE_PIPELINED_EEPROM)
+    eeprom_busy_wait();
+#endif
+
+#if (USE_EEPROM_UPDATE)
+    uint8_t old = read_eeprom_byte(addr);
+
+    /* unchanged bytes are not written */
+    if (old == val)
+    {
+        addr++;
+        return;
+    }
+#endif /* (USE_EEPROM_UPDATE) */
+
+    EEARL = addr;
+    EEARH = (addr >> 8);
+    EEDR = val;
+    addr++;
+
+    STATS_INC(STATS_EEPROM_BYTES);
+
+#if (USE_EEPROM_UPDATE) && defined (EEPM0)
+    if (val == 0xFF)
+    {
+        /* erase only */
+        EECR = (1<<EEPM0);
+    }
+    else if ((old & val) == val)
+    {
+        /* write only, no bit needs to be set */
+        EECR = (1<<EEPM1);
+    }
+    else
+    {
+        /* erase and write (atomic) */
+        EECR = 0x00;
+    }
+#endif /* (USE_EEPROM_UPDATE) && defined (EEPM0) */
+
+#if defined (EEWE)
+    EECR |= (1<<EEMWE);
+    EECR |= (1<<EEWE);
+#elif defined (EEPE)
+    EECR |= (1<<EEMPE);
+    EECR |= (1<<EEPE);
+#else
+#error "EEWE/EEPE not defined"
+#endif
+
+#if (USE_PIPELINED_EEPROM == 0)
+    eeprom_busy_wait();
+#endif
+} /* write_eeprom_byte */
+
+
+#if (USE_PIPELINED_EEPROM)
+/* *************************************************************************
+ * eeprom_poll
+ * ************************************************************************* */
+static void eeprom_poll(void)
+{
+    if (eeprom_is_ready())
+    {
+        if (ee_count)
+        {
+            /* start next byte, write continues in the background */
+            write_eeprom_byte(buf[ee_tail]);
+            ee_tail = (ee_tail +1) % SPM_PAGESIZE;
+            ee_count--;
+        }
+#if (USE_UART == 0) && defined (TWCR) && (USE_CLOCKSTRETCH == 0)
+        else if (ee_nak)
+        {
+            /* all bytes written, ACK own address again */
+            ee_nak = 0;
+            TWCR = (1<<TWEA) | (1<<TWEN);
+        }
+#endif
+    }
+} /* eeprom_poll */
+
+
+/* *************************************************************************
+ * eeprom_sync
+ * ************************************************************************* */
+static void eeprom_sync(void)
+{
+    while (ee_count)
+    {
+        eeprom_poll();
+    }
+
+    eeprom_busy_wait();
+} /* eeprom_sync */
+#endif /* (USE_PIPELINED_EEPROM) */
+
+
+#if (USE_CLOCKSTRETCH == 0) && (USE_PIPELINED_EEPROM == 0)
+/* *************************************************************************
+ * write_eeprom_buffer
+ * ************************************************************************* */
+static void write_eeprom_buffer(pagepos_t size)
+{
+    uint8_t *p = buf;
+
+    while (size--)
+    {
+        write_eeprom_byte(*p++);
+    }
+} /* write_eeprom_buffer */
+#endif /* (USE_CLOCKSTRETCH == 0) && (USE_PIPELINED_EEPROM == 0) */
+#endif /* EEPROM_SUPPORT */
+
+
+#if (APPINFO_SUPPORT)
+/* *************************************************************************
+ * read_app_crc
+ * ************************************************************************* */
+static uint16_t read_app_crc(address_t size)
+{
+    uint16_t result = 0xFFFF;
+    address_t address = 0x0000;
+
+#if (USE_PIPELINED_WRITE)
+    flash_sync();
+#endif
+
+    /* real flash content (incl. patched vectors), as seen after reset */
+    while (size--)
+    {
+        result = _crc_ccitt_update(result, FLASH_READ_BYTE(address++));
+    }
+
+    return result;
+} /* read_app_crc */
+
+
+/* *************************************************************************
+ * write_appinfo
+ * ************************************************************************* */
+static void write_appinfo(void)
+{
+    address_t size = addr;
+
+#if (JOURNAL_SUPPORT)
+    /* update not complete (committed pages != page count): store invalid size */
+    if ((read_eeprom_byte(JOURNAL_EEPROM_ADDR +2) != read_eeprom_byte(JOURNAL_EEPROM_ADDR +4)) ||
+        (read_eeprom_byte(JOURNAL_EEPROM_ADDR +3) != read_eeprom_byte(JOURNAL_EEPROM_ADDR +5))
+       )
+    {
+        size = 0x0000;
+    }
+#endif /* (JOURNAL_SUPPORT) */
+
+    if (size > BOOTLOADER_START)
+    {
+        size = 0x0000;
+    }
+
+    uint16_t app_crc = read_app_crc(size);
+
+    addr = APPINFO_EEPROM_ADDR;
+#if (FLASH_ADDR24)
+    write_eeprom_byte(size >> 16);
+#endif
+    write_eeprom_byte(size >> 8);
+    write_eeprom_byte(size & 0xFF);
+    write_eeprom_byte(app_crc >> 8);
+    write_eeprom_byte(app_crc & 0xFF);
+} /* write_appinfo */
 
-/* SLA+W */
-#define CMD_SWITCH_APPLICATION  CMD_READ_VERSION
-/* internal mappings */
-#define CMD_BOOT_BOOTLOADER     (0x10 | CMD_SWITCH_APPLICATION) /* only in APP */
-#define CMD_BOOT_APPLICATION    (0x20 | CMD_SWITCH_APPLICATION)
 
-/* CMD_SWITCH_APPLICATION parameter */
-#define BOOTTYPE_BOOTLOADER     0x00    /* only in APP */
-#define BOOTTYPE_APPLICATION    0x80
+/* *************************************************************************
+ * check_appinfo
+ * ************************************************************************* */
+static void check_appinfo(void)
+{
+    address_t size = 0;
+    uint8_t i;
 
-/* CMD_{READ|WRITE}_* parameter */
-#define MEMTYPE_CHIPINFO        0x00
-#define MEMTYPE_FLASH           0x01
-#define MEMTYPE_EEPROM          0x02
+    for (i = 0; i < APPINFO_SIZE_LENGTH; i++)
+    {
+        size = (size << 8) | read_eeprom_byte(APPINFO_EEPROM_ADDR + i);
+    }
 
-/*
- * LED_GN flashes with 20Hz (while bootloader is running)
- * LED_RT flashes on TWI activity
- *
- * bootloader twi-protocol:
- * - abort boot timeout:
- *   SLA+W, 0x00, STO
- *
- * - show bootloader version
- *   SLA+W, 0x01, SLA+R, {16 bytes}, STO
- *
- * - start application
- *   SLA+W, 0x01, 0x80, STO
- *
- * - read chip info: 3byte signature, 1byte page size, 2byte flash size, 2byte eeprom size
- *   SLA+W, 0x02, 0x00, 0x00, 0x00, SLA+R, {8 bytes}, STO
- *
- * - read one (or more) flash bytes
- *   SLA+W, 0x02, 0x01, addrh, addrl, SLA+R, {* bytes}, STO
- *
- * - read one (or more) eeprom bytes
- *   SLA+W, 0x02, 0x02, addrh, addrl, SLA+R, {* bytes}, STO
- *
- * - write one flash page
- *   SLA+W, 0x02, 0x01, addrh, addrl, {* bytes}, STO
- *
- * - write one (or more) eeprom bytes
- *   SLA+W, 0x02, 0x02, addrh, addrl, {* bytes}, STO
- */
+    /* no application info -> default boot timeout */
+    if (size == APPINFO_SIZE_ERASED)
+    {
+        return;
+    }
 
-const static uint8_t info[16] = VERSION_STRING;
-const static uint8_t chipinfo[8] = {
-    SIGNATURE_0, SIGNATURE_1, SIGNATURE_2,
-    SPM_PAGESIZE,
+    if ((size != 0x0000) && (size <= BOOTLOADER_START)
+#if (APPINFO_FULL_CHECK)
+        && (read_app_crc(size) == ((read_eeprom_byte(APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH) << 8) |
+                                   read_eeprom_byte(APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH +1)))
+#endif /* (APPINFO_FULL_CHECK) */
+       )
+    {
+        /* valid application -> start after the first (short) timer period */
+        TCNT0 = 0xFF - TIMER_MSEC2TICKS(FASTBOOT_TIMEOUT_MS);
+        boot_timeout = 1;
+    }
+    else
+    {
+        /* invalid application -> stay in bootloader */
+        boot_timeout = 0;
+    }
+} /* check_appinfo */
 
-    (BOOTLOADER_START >> 8) & 0xFF,
-    BOOTLOADER_START & 0xFF,
 
-#if (EEPROM_SUPPORT)
-    ((E2END +1) >> 8 & 0xFF),
-    (E2END +1) & 0xFF
-#else
-    0x00, 0x00
-#endif
-};
+/* *************************************************************************
+ * invalidate_appinfo
+ * ************************************************************************* */
+static void invalidate_appinfo(void)
+{
+    address_t save_addr = addr;
 
-static uint8_t boot_timeout = TIMER_MSEC2IRQCNT(TIMEOUT_MS);
-static uint8_t cmd = CMD_WAIT;
+    /* flash content changes, stay in bootloader until new application info is written */
+    for (addr = APPINFO_EEPROM_ADDR; addr < (APPINFO_EEPROM_ADDR + APPINFO_SIZE_LENGTH); )
+    {
+        if (read_eeprom_byte(addr) != 0x00)
+        {
+            write_eeprom_byte(0x00);
+        }
+        else
+        {
+            addr++;
+        }
+    }
 
-/* flash buffer */
-static uint8_t buf[SPM_PAGESIZE];
-static uint16_t addr;
+    addr = save_addr;
+} /* invalidate_appinfo */
+#endif /* (APPINFO_SUPPORT) */
 
-#if (VIRTUAL_BOOT_SECTION)
-/* reset/application vectors received from host, needed for verify read */
-static uint8_t rstvect_save[2];
-static uint8_t appvect_save[2];
-#endif /* (VIRTUAL_BOOT_SECTION) */
 
 /* *************************************************************************
  * write_flash_page
  * ************************************************************************* */
 static void write_flash_page(void)
 {
-    uint16_t pagestart = addr;
-    uint8_t size = SPM_PAGESIZE;
+    address_t pagestart = addr;
+    pagepos_t size = SPM_PAGESIZE;
     uint8_t *p = buf;
 
 #if (VIRTUAL_BOOT_SECTION)
@@ -226,8 +1077,29 @@ static void write_flash_page(void)
 
     if (pagestart < BOOTLOADER_START)
     {
+        TRACE(TRACE_COMMIT_BEGIN);
+        STATS_INC(STATS_PAGES);
+
+#if (APPINFO_SUPPORT)
+        invalidate_appinfo();
+#endif
+
+#if (USE_PIPELINED_EEPROM)
+        /* SPM is not possible while an eeprom write is in progress */
+        eeprom_busy_wait();
+#endif
+
+#if (USE_PIPELINED_WRITE)
+        /* temporary page buffer is in use until the previous page is written */
+        flash_sync();
+#else
+#if (STATS_SUPPORT)
+        /* erase + write take less than 256 timer ticks */
+        uint8_t spm_ticks = TCNT0;
+#endif
         boot_page_erase(pagestart);
         boot_spm_busy_wait();
+#endif
 
         do {
             uint16_t data = *p++;
@@ -238,70 +1110,141 @@ static void write_flash_page(void)
             size -= 2;
         } while (size);
 
+#if (USE_PIPELINED_WRITE)
+        /* page buffer is filled, erase and write continue in flash_poll() */
+#if (STATS_SUPPORT)
+        spm_ticks = TCNT0;
+#endif
+        boot_page_erase(pagestart);
+        spm_pagestart = pagestart;
+        spm_state = SPM_STATE_ERASE;
+#else
         boot_page_write(pagestart);
         boot_spm_busy_wait();
 
 #if defined (ASRE) || defined (RWWSRE)
         /* only required for bootloader section */
         boot_rww_enable();
+#endif
+        TRACE(TRACE_COMMIT_END);
+        STATS_ADD(STATS_SPM_TICKS, 4, (uint8_t)(TCNT0 - spm_ticks));
+#endif /* (USE_PIPELINED_WRITE) */
+
+#if (VERIFY_SUPPORT)
+        verify_flash_page(pagestart);
 #endif
     }
+#if (VERIFY_SUPPORT)
+    else
+    {
+        /* bootloader section is not writeable, page is dropped */
+        write_status |= WRITE_STATUS_ADDRESS_REJECTED;
+    }
+#endif /* (VERIFY_SUPPORT) */
 } /* write_flash_page */
 
 
-#if (EEPROM_SUPPORT)
+#if (PARTIAL_WRITE_SUPPORT)
 /* *************************************************************************
- * read_eeprom_byte
+ * write_flash_partial
  * ************************************************************************* */
-static uint8_t read_eeprom_byte(uint16_t address)
+static void write_flash_partial(void)
 {
-    EEARL = address;
-    EEARH = (address >> 8);
-    EECR |= (1<<EERE);
+    /* page is incomplete at the Stop Condition, keep the remaining flash content */
+    read_flash_page(pos, SPM_PAGESIZE);
+    pos = 0;
 
-    return EEDR;
-} /* read_eeprom_byte */
+    write_flash_page();
+} /* write_flash_partial */
+#endif /* (PARTIAL_WRITE_SUPPORT) */
 
 
+#if (ERASE_SUPPORT)
 /* *************************************************************************
- * write_eeprom_byte
+ * erase_flash
  * ************************************************************************* */
-static void write_eeprom_byte(uint8_t val)
+static void erase_flash(void)
 {
-    EEARL = addr;
-    EEARH = (addr >> 8);
-    EEDR = val;
-    addr++;
+    addr &= ~(SPM_PAGESIZE -1);
 
-#if defined (EEWE)
-    EECR |= (1<<EEMWE);
-    EECR |= (1<<EEWE);
-#elif defined (EEPE)
-    EECR |= (1<<EEMPE);
-    EECR |= (1<<EEPE);
-#else
-#error "EEWE/EEPE not defined"
+#if (APPINFO_SUPPORT)
+    invalidate_appinfo();
 #endif
 
+#if (USE_PIPELINED_EEPROM)
     eeprom_busy_wait();
-} /* write_eeprom_byte */
+#endif
+
+#if (USE_PIPELINED_WRITE)
+    flash_sync();
+#endif
 
+    do {
+        if (addr >= BOOTLOADER_START)
+        {
+            break;
+        }
 
-#if (USE_CLOCKSTRETCH == 0)
+#if (VIRTUAL_BOOT_SECTION)
+        if (addr == (RSTVECT_ADDR & ~(SPM_PAGESIZE -1)))
+        {
+            /* erased vector page, write_flash_page() installs the bootloader reset vector */
+            pagepos_t i;
+
+            for (i = 0; i < SPM_PAGESIZE; i++)
+            {
+                buf[i] = 0xFF;
+            }
+
+            write_flash_page();
+            continue;
+        }
+#endif /* (VIRTUAL_BOOT_SECTION) */
+
+        boot_page_erase(addr);
+        boot_spm_busy_wait();
+
+        addr += SPM_PAGESIZE;
+    } while (--erase_count);
+
+#if defined (ASRE) || defined (RWWSRE)
+    boot_rww_enable();
+#endif
+
+    /* an empty message (e.g. address probe) must not erase again */
+    cmd = CMD_WAIT;
+} /* erase_flash */
+#endif /* (ERASE_SUPPORT) */
+
+
+#if (ADDRESS_EEPROM_SUPPORT) || (ADDRESS_STRAP_SUPPORT)
 /* *************************************************************************
- * write_eeprom_buffer
+ * read_slave_address
  * ************************************************************************* */
-static void write_eeprom_buffer(uint8_t size)
+static uint8_t read_slave_address(void)
 {
-    uint8_t *p = buf;
+    uint8_t address = TWI_ADDRESS;
 
-    while (size--)
+#if (ADDRESS_EEPROM_SUPPORT)
+    uint8_t val = read_eeprom_byte(ADDRESS_EEPROM_ADDR);
+
+    /* erased (0xFF) or reserved address -> keep TWI_ADDRESS */
+    if ((val >= 0x08) && (val <= 0x77))
     {
-        write_eeprom_byte(*p++);
+        address = val;
     }
-} /* write_eeprom_buffer */
-#endif /* (USE_CLOCKSTRETCH == 0) */
-#endif /* EEPROM_SUPPORT */
+#endif /* (ADDRESS_EEPROM_SUPPORT) */
+
+#if (ADDRESS_STRAP_SUPPORT)
+    address += ADDRESS_STRAP_READ();
+
+    /* leave the pins as after reset */
+    ADDRESS_STRAP_OFF();
+#endif /* (ADDRESS_STRAP_SUPPORT) */
+
+    return (address << 1);
+} /* read_slave_address */
+#endif /* (ADDRESS_EEPROM_SUPPORT) || (ADDRESS_STRAP_SUPPORT) */
 
 
 /* *************************************************************************
@@ -311,9 +1254,32 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
 {
     uint8_t ack = 0x01;
 
+#if (FLASH_ADDR24)
+    if (addr24 && (bcnt >= 2))
+    {
+        if (bcnt == 2)
+        {
+            /* addrx, addrh / addrl follow as in the 2byte variant */
+            addr = data;
+            return ack;
+        }
+
+        bcnt--;
+    }
+#endif /* (FLASH_ADDR24) */
+
     switch (bcnt)
     {
         case 0:
+#if (TWI_GENERAL_CALL) && (TWI_GROUP_ADDRESS == 0x00)
+            /* hardware general call (2nd byte bit0 set) of another master, ignore */
+            if (gcall && (data & 0x01))
+            {
+                ack = 0x00;
+                break;
+            }
+#endif /* (TWI_GENERAL_CALL) && (TWI_GROUP_ADDRESS == 0x00) */
+
             switch (data)
             {
                 case CMD_SWITCH_APPLICATION:
@@ -327,6 +1293,15 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
                     break;
 
                 default:
+#if (TWI_GENERAL_CALL)
+                    /* ignore general call messages for other devices */
+                    if (gcall)
+                    {
+                        ack = 0x00;
+                        break;
+                    }
+#endif /* (TWI_GENERAL_CALL) */
+
                     /* boot app now */
                     cmd = CMD_BOOT_APPLICATION;
                     ack = 0x00;
@@ -335,6 +1310,12 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
             break;
 
         case 1:
+            pos = 0;
+#if (FLASH_ADDR24)
+            addr24 = 0;
+            addr = 0;
+#endif
+
             switch (cmd)
             {
                 case CMD_SWITCH_APPLICATION:
@@ -347,6 +1328,14 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
                     break;
 
                 case CMD_ACCESS_MEMORY:
+#if (USE_PIPELINED_EEPROM)
+                    /* buf / eeprom are in use until the previous eeprom write is done */
+                    eeprom_sync();
+#endif
+#if (FLASH_ADDR24)
+                    addr24 = data & MEMTYPE_ADDR24;
+                    data &= ~MEMTYPE_ADDR24;
+#endif
                     if (data == MEMTYPE_CHIPINFO)
                     {
                         cmd = CMD_ACCESS_CHIPINFO;
@@ -355,12 +1344,80 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
                     {
                         cmd = CMD_ACCESS_FLASH;
                     }
+#if (CRC_SUPPORT)
+                    else if (data == MEMTYPE_FLASH_CRC)
+                    {
+                        cmd = CMD_ACCESS_FLASH_CRC;
+                        crc_size = SPM_PAGESIZE;
+                    }
+#endif /* (CRC_SUPPORT) */
+#if (APPINFO_SUPPORT)
+                    else if (data == MEMTYPE_APPINFO)
+                    {
+                        cmd = CMD_ACCESS_APPINFO;
+                    }
+#endif /* (APPINFO_SUPPORT) */
+#if (VERIFY_SUPPORT)
+                    else if (data == MEMTYPE_WRITE_STATUS)
+                    {
+                        cmd = CMD_ACCESS_STATUS;
+                    }
+#endif /* (VERIFY_SUPPORT) */
+#if (CHUNKED_WRITE_SUPPORT)
+                    else if (data == MEMTYPE_PAGEBUF)
+                    {
+                        cmd = CMD_ACCESS_PAGEBUF;
+                    }
+                    else if (data == MEMTYPE_PAGEBUF_COMMIT)
+                    {
+                        cmd = CMD_COMMIT_PAGEBUF;
+                    }
+#endif /* (CHUNKED_WRITE_SUPPORT) */
+#if (ERASE_SUPPORT)
+                    else if (data == MEMTYPE_FLASH_ERASE)
+                    {
+                        cmd = CMD_ERASE_FLASH;
+                        erase_count = 0;
+                    }
+#endif /* (ERASE_SUPPORT) */
+#if (RLE_SUPPORT)
+                    else if (data == MEMTYPE_FLASH_RLE)
+                    {
+                        cmd = CMD_WRITE_FLASH_RLE;
+                        rle_count = 0;
+                    }
+#endif /* (RLE_SUPPORT) */
 #if (EEPROM_SUPPORT)
                     else if (data == MEMTYPE_EEPROM)
                     {
                         cmd = CMD_ACCESS_EEPROM;
+#if (USE_PIPELINED_EEPROM)
+                        ee_tail = 0;
+#endif
                     }
 #endif /* (EEPROM_SUPPORT) */
+#if (JOURNAL_SUPPORT)
+                    else if (data == MEMTYPE_JOURNAL)
+                    {
+                        /* eeprom access at an offset within the journal */
+                        cmd = CMD_ACCESS_JOURNAL;
+#if (USE_PIPELINED_EEPROM)
+                        ee_tail = 0;
+#endif
+                    }
+#endif /* (JOURNAL_SUPPORT) */
+#if (TRACE_SUPPORT)
+                    else if (data == MEMTYPE_TRACE)
+                    {
+                        cmd = CMD_ACCESS_TRACE;
+                    }
+#endif /* (TRACE_SUPPORT) */
+#if (STATS_SUPPORT)
+                    else if (data == MEMTYPE_STATS)
+                    {
+                        cmd = CMD_ACCESS_STATS;
+                    }
+#endif /* (STATS_SUPPORT) */
                     else
                     {
                         ack = 0x00;
@@ -377,13 +1434,56 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
         case 3:
             addr <<= 8;
             addr |= data;
+
+#if (CHUNKED_WRITE_SUPPORT)
+            if ((bcnt == 3) && (cmd == CMD_COMMIT_PAGEBUF))
+            {
+                /* page buffer was filled by previous messages */
+                addr &= ~(SPM_PAGESIZE -1);
+#if (USE_CLOCKSTRETCH)
+                write_flash_page();
+                cmd = CMD_WAIT;
+#else
+                cmd = CMD_WRITE_FLASH_PAGE;
+#endif
+                ack = 0x00;
+            }
+#endif /* (CHUNKED_WRITE_SUPPORT) */
+
+#if (JOURNAL_SUPPORT)
+            if ((bcnt == 3) && (cmd == CMD_ACCESS_JOURNAL))
+            {
+                addr += JOURNAL_EEPROM_ADDR;
+                cmd = CMD_ACCESS_EEPROM;
+            }
+#endif /* (JOURNAL_SUPPORT) */
             break;
 
         default:
             switch (cmd)
             {
 #if (EEPROM_SUPPORT)
+#if (USE_PIPELINED_EEPROM)
+                case CMD_ACCESS_EEPROM:
 #if (USE_CLOCKSTRETCH)
+                    /* ring is full: hold SCL until the next byte is written */
+                    while (ee_count >= SPM_PAGESIZE)
+                    {
+                        eeprom_poll();
+                    }
+#endif
+                    /* written by eeprom_poll() while the next bytes are received */
+                    buf[(ee_tail + ee_count) % SPM_PAGESIZE] = data;
+                    ee_count++;
+
+#if (USE_CLOCKSTRETCH == 0)
+                    if (ee_count >= SPM_PAGESIZE)
+                    {
+                        ack = 0x00;
+                    }
+#endif
+                    break;
+#elif (USE_CLOCKSTRETCH)
                 case CMD_ACCESS_EEPROM:
                     write_eeprom_byte(data);
                     break;
@@ -393,28 +1493,116 @@ static uint8_t TWI_data_write(uint8_t bcnt, uint8_t data)
                     /* fall through */
 
                 case CMD_WRITE_EEPROM_PAGE:
-#endif /* (USE_CLOCKSTRETCH) */
+                    if (pos < SPM_PAGESIZE)
+                    {
+                        buf[pos++] = data;
+                    }
+
+                    if (pos >= SPM_PAGESIZE)
+                    {
+                        ack = 0x00;
+                    }
+                    break;
+#endif /* (USE_PIPELINED_EEPROM) */
 #endif /* (EEPROM_SUPPORT) */
+
                 case CMD_ACCESS_FLASH:
-                {
-                    uint8_t pos = bcnt -4;
+#if (PARTIAL_WRITE_SUPPORT)
+                    if (bcnt == 4)
+                    {
+                        /* write starts within a page, keep the flash content before it */
+                        pos = addr % SPM_PAGESIZE;
+                        addr -= pos;
+                        read_flash_page(0, pos);
+                    }
+#endif /* (PARTIAL_WRITE_SUPPORT) */
+
+                    buf[pos++] = data;
+                    if (pos >= SPM_PAGESIZE)
+                    {
+                        /* write_flash_page() advances addr to the next page */
+                        pos = 0;
+#if (USE_CLOCKSTRETCH)
+                        /* streaming write: next page follows in the same transaction */
+                        write_flash_page();
+#if (STREAM_SUPPORT == 0)
+                        ack = 0x00;
+#endif
+#else
+                        /* page complete, written after STOP (no clockstretching) */
+                        cmd = CMD_WRITE_FLASH_PAGE;
+                        ack = 0x00;
+#endif
+                    }
+                    break;
+
+#if (RLE_SUPPORT)
+                case CMD_WRITE_FLASH_RLE:
+                    if (!(rle_count & 0x7F))
+                    {
+                        /* control byte: bit7 set -> repeat next byte, else copy next bytes */
+                        rle_count = data;
+                        break;
+                    }
+
+                    do {
+                        buf[pos++] = data;
+                        rle_count--;
+                    } while ((rle_count & 0x80) && (rle_count & 0x7F) &&
+                             (pos < SPM_PAGESIZE));
 
-                    buf[pos] = data;
-                    if (pos >= (SPM_PAGESIZE -1))
+                    if (pos >= SPM_PAGESIZE)
                     {
-                        if (cmd == CMD_ACCESS_FLASH)
-                        {
 #if (USE_CLOCKSTRETCH)
-                            write_flash_page();
+                        write_flash_page();
+                        cmd = CMD_WAIT;
 #else
-                            cmd = CMD_WRITE_FLASH_PAGE;
+                        cmd = CMD_WRITE_FLASH_PAGE;
 #endif
-                        }
+                        ack = 0x00;
+                    }
+                    break;
+#endif /* (RLE_SUPPORT) */
+
+#if (APPINFO_SUPPORT)
+                case CMD_ACCESS_APPINFO:
+                    /* application size, crc is calculated by bootloader */
+                    addr <<= 8;
+                    addr |= data;
 
+                    if (++pos >= APPINFO_SIZE_LENGTH)
+                    {
+#if (USE_CLOCKSTRETCH)
+                        write_appinfo();
+#else
+                        cmd = CMD_WRITE_APPINFO;
+#endif
                         ack = 0x00;
                     }
                     break;
-                }
+#endif /* (APPINFO_SUPPORT) */
+
+#if (CHUNKED_WRITE_SUPPORT)
+                case CMD_ACCESS_PAGEBUF:
+                    buf[addr++ % SPM_PAGESIZE] = data;
+                    break;
+#endif /* (CHUNKED_WRITE_SUPPORT) */
+
+#if (ERASE_SUPPORT)
+                case CMD_ERASE_FLASH:
+                    /* optional number of pages, erased after the Stop Condition */
+                    erase_count <<= 8;
+                    erase_count |= data;
+                    break;
+#endif /* (ERASE_SUPPORT) */
+
+#if (CRC_SUPPORT)
+                case CMD_ACCESS_FLASH_CRC:
+                    /* optional block size, default is one page */
+                    crc_size <<= 8;
+                    crc_size |= data;
+                    break;
+#endif /* (CRC_SUPPORT) */
 
                 default:
                     ack = 0x00;
@@ -447,40 +1635,70 @@ static uint8_t TWI_data_read(uint8_t bcnt)
             break;
 
         case CMD_ACCESS_FLASH:
-            switch (addr)
+            data = read_flash_byte(addr++);
+            break;
+
+#if (CRC_SUPPORT)
+        case CMD_ACCESS_FLASH_CRC:
+            /* calculate crc of next page, return msb first */
+            if (!(bcnt & 0x01))
             {
-/* return cached values for verify read */
-#if (VIRTUAL_BOOT_SECTION)
-                case RSTVECT_ADDR:
-                    data = rstvect_save[0];
-                    break;
+                crc = read_flash_crc(crc_size);
+                data = (crc >> 8);
+            }
+            else
+            {
+                data = crc;
+            }
+            break;
+#endif /* (CRC_SUPPORT) */
+
+#if (EEPROM_SUPPORT)
+        case CMD_ACCESS_EEPROM:
+#if (USE_PIPELINED_EEPROM)
+            /* repeated start after a write: addr is still in use by eeprom_poll() */
+            eeprom_sync();
+#endif
+            data = read_eeprom_byte(addr++);
+            break;
+#endif /* (EEPROM_SUPPORT) */
 
-                case (RSTVECT_ADDR + 1):
-                    data = rstvect_save[1];
-                    break;
+#if (APPINFO_SUPPORT)
+        case CMD_ACCESS_APPINFO:
+            data = read_eeprom_byte(APPINFO_EEPROM_ADDR + (bcnt % APPINFO_LENGTH));
+            break;
+#endif /* (APPINFO_SUPPORT) */
 
-                case APPVECT_ADDR:
-                    data = appvect_save[0];
-                    break;
+#if (VERIFY_SUPPORT)
+        case CMD_ACCESS_STATUS:
+            data = write_status;
+            write_status = WRITE_STATUS_OK;
+            break;
+#endif /* (VERIFY_SUPPORT) */
 
-                case (APPVECT_ADDR + 1):
-                    data = appvect_save[1];
-                    break;
-#endif /* (VIRTUAL_BOOT_SECTION) */
+#if (CHUNKED_WRITE_SUPPORT)
+        case CMD_ACCESS_PAGEBUF:
+            data = buf[addr++ % SPM_PAGESIZE];
+            break;
+#endif /* (CHUNKED_WRITE_SUPPORT) */
 
-                default:
-                    data = pgm_read_byte_near(addr);
-                    break;
+#if (TRACE_SUPPORT)
+        case CMD_ACCESS_TRACE:
+            data = TRACE_NONE;
+            if (addr < sizeof(trace_buf))
+            {
+                data = trace_buf[(trace_head + addr) % sizeof(trace_buf)];
             }
-
             addr++;
             break;
+#endif /* (TRACE_SUPPORT) */
 
-#if (EEPROM_SUPPORT)
-        case CMD_ACCESS_EEPROM:
-            data = read_eeprom_byte(addr++);
+#if (STATS_SUPPORT)
+        case CMD_ACCESS_STATS:
+            bcnt %= sizeof(stats);
+            data = stats[bcnt];
             break;
-#endif /* (EEPROM_SUPPORT) */
+#endif /* (STATS_SUPPORT) */
 
         default:
             data = 0xFF;
@@ -491,7 +1709,92 @@ static uint8_t TWI_data_read(uint8_t bcnt)
 } /* TWI_data_read */
 
 
-#if defined (TWCR)
+/* *************************************************************************
+ * TWI_data_pending
+ * ************************************************************************* */
+static uint8_t TWI_data_pending(void)
+{
+    /* work deferred until the Stop Condition */
+    return (0
+#if (USE_CLOCKSTRETCH == 0)
+            || (cmd == CMD_WRITE_FLASH_PAGE)
+#if (EEPROM_SUPPORT) && (USE_PIPELINED_EEPROM == 0)
+            || (cmd == CMD_WRITE_EEPROM_PAGE)
+#endif
+#if (APPINFO_SUPPORT)
+            || (cmd == CMD_WRITE_APPINFO)
+#endif
+#endif /* (USE_CLOCKSTRETCH == 0) */
+#if (PARTIAL_WRITE_SUPPORT)
+            || ((cmd == CMD_ACCESS_FLASH) && pos)
+#endif
+#if (ERASE_SUPPORT)
+            || (cmd == CMD_ERASE_FLASH)
+#endif
+#if (RLE_SUPPORT) && (VERIFY_SUPPORT)
+            || ((cmd == CMD_WRITE_FLASH_RLE) && (pos || (rle_count & 0x7F)))
+#endif
+           );
+} /* TWI_data_pending */
+
+
+/* *************************************************************************
+ * TWI_data_stop
+ * end of a message with pending work, independent of the transport
+ * ************************************************************************* */
+static void TWI_data_stop(void)
+{
+#if (USE_CLOCKSTRETCH == 0)
+#if (EEPROM_SUPPORT) && (USE_PIPELINED_EEPROM == 0)
+    if (cmd == CMD_WRITE_EEPROM_PAGE)
+    {
+        write_eeprom_buffer(pos);
+        return;
+    }
+#endif /* (EEPROM_SUPPORT) && (USE_PIPELINED_EEPROM == 0) */
+
+#if (APPINFO_SUPPORT)
+    if (cmd == CMD_WRITE_APPINFO)
+    {
+        write_appinfo();
+        return;
+    }
+#endif /* (APPINFO_SUPPORT) */
+#endif /* (USE_CLOCKSTRETCH == 0) */
+
+#if (RLE_SUPPORT) && (VERIFY_SUPPORT)
+    if (cmd == CMD_WRITE_FLASH_RLE)
+    {
+        /* message ended within the page or a run: page is discarded */
+        write_status |= WRITE_STATUS_INCOMPLETE;
+        cmd = CMD_WAIT;
+        return;
+    }
+#endif /* (RLE_SUPPORT) && (VERIFY_SUPPORT) */
+
+#if (PARTIAL_WRITE_SUPPORT)
+    if (cmd == CMD_ACCESS_FLASH)
+    {
+        write_flash_partial();
+        return;
+    }
+#endif /* (PARTIAL_WRITE_SUPPORT) */
+
+#if (ERASE_SUPPORT)
+    if (cmd == CMD_ERASE_FLASH)
+    {
+        erase_flash();
+        return;
+    }
+#endif /* (ERASE_SUPPORT) */
+
+#if (USE_CLOCKSTRETCH == 0)
+    write_flash_page();
+#endif
+} /* TWI_data_stop */
+
+
+#if (USE_UART == 0) && defined (TWCR)
 /* *************************************************************************
  * TWI_vect
  * ************************************************************************* */
@@ -502,27 +1805,78 @@ static void TWI_vect(void)
 
     switch (TWSR & 0xF8)
     {
+#if (TWI_GENERAL_CALL)
+        /* general call received, ACK returned -> receive data and ACK */
+        case 0x70:
+            bcnt = 0;
+            gcall = 1;
+            LED_RT_ON();
+            TRACE(TRACE_START);
+            break;
+#endif /* (TWI_GENERAL_CALL) */
+
         /* SLA+W received, ACK returned -> receive data and ACK */
         case 0x60:
             bcnt = 0;
+#if (TWI_GENERAL_CALL)
+            gcall = 0;
+#endif
+#if (TWI_GROUP_ADDRESS != 0x00)
+            /* address mask also matches addresses other than own and group address */
+            if (TWDR != TWI_SLA)
+            {
+                if (TWDR != TWI_GCALL_SLA)
+                {
+                    /* not addressed -> NAK the data */
+                    control &= ~(1<<TWEA);
+                    break;
+                }
+
+                gcall = 1;
+            }
+#endif /* (TWI_GROUP_ADDRESS != 0x00) */
             LED_RT_ON();
+            TRACE(TRACE_START);
             break;
 
         /* prev. SLA+W, data received, ACK returned -> receive data and ACK */
         case 0x80:
-            if (TWI_data_write(bcnt++, TWDR) == 0x00)
+#if (TWI_GENERAL_CALL)
+        /* prev. general call, data received, ACK returned -> receive data and ACK */
+        case 0x90:
+#endif
+            if (TWI_data_write(bcnt, TWDR) == 0x00)
             {
                 /* the ACK returned by TWI_data_write() is not for the current
                  * data in TWDR, but for the next byte received
                  */
                 control &= ~(1<<TWEA);
             }
+
+#if (BCNT_SATURATE)
+            if (bcnt != 0xFF)
+            {
+                bcnt++;
+            }
+#else
+            bcnt++;
+#endif
             break;
 
         /* SLA+R received, ACK returned -> send data */
         case 0xA8:
+#if (TWI_GROUP_ADDRESS != 0x00)
+            /* group address (or other masked address) is write only */
+            if (TWDR != (TWI_SLA | 0x01))
+            {
+                TWDR = 0xFF;
+                control &= ~(1<<TWEA);
+                break;
+            }
+#endif /* (TWI_GROUP_ADDRESS != 0x00) */
             bcnt = 0;
             LED_RT_ON();
+            TRACE(TRACE_START);
             /* fall through */
 
         /* prev. SLA+R, data sent, ACK returned -> send data */
@@ -532,55 +1886,66 @@ static void TWI_vect(void)
 
         /* prev. SLA+W, data received, NACK returned -> IDLE */
         case 0x88:
-            TWI_data_write(bcnt++, TWDR);
+#if (TWI_GENERAL_CALL)
+        /* prev. general call, data received, NACK returned -> IDLE */
+        case 0x98:
+#endif
+            /* data was not accepted, discard it */
             /* fall through */
 
         /* STOP or repeated START -> IDLE */
         case 0xA0:
-#if (USE_CLOCKSTRETCH == 0)
-            if ((cmd == CMD_WRITE_FLASH_PAGE)
-#if (EEPROM_SUPPORT)
-                || (cmd == CMD_WRITE_EEPROM_PAGE)
-#endif
-               )
+            TRACE(TRACE_STOP);
+            if (TWI_data_pending())
             {
+#if (USE_CLOCKSTRETCH == 0)
                 /* disable ACK for now, re-enable after page write */
                 control &= ~(1<<TWEA);
                 TWCR = (1<<TWINT) | control;
-
-#if (EEPROM_SUPPORT)
-                if (cmd == CMD_WRITE_EEPROM_PAGE)
-                {
-                    write_eeprom_buffer(bcnt -4);
-                }
-                else
-#endif /* (EEPROM_SUPPORT) */
-                {
-                    write_flash_page();
-                }
+                TRACE(TRACE_NAK_BUSY);
+                STATS_INC(STATS_NAK_BUSY);
+#endif
+                /* with clockstretching SCL is held low on the next message */
+                TWI_data_stop();
             }
-#endif /* (USE_CLOCKSTRETCH) */
 
             bcnt = 0;
             /* fall through */
 
         /* prev. SLA+R, data sent, NACK returned -> IDLE */
         case 0xC0:
+#if (TWI_GROUP_ADDRESS != 0x00)
+        /* prev. SLA+R, last data sent, ACK returned -> IDLE */
+        case 0xC8:
+#endif
             LED_RT_OFF();
+#if (USE_PIPELINED_EEPROM) && (USE_CLOCKSTRETCH == 0)
+            if (ee_count)
+            {
+                /* NAK own address until eeprom_poll() has written the ring */
+                ee_nak = 1;
+                control &= ~(1<<TWEA);
+                TRACE(TRACE_NAK_BUSY);
+                STATS_INC(STATS_NAK_BUSY);
+                break;
+            }
+#endif /* (USE_PIPELINED_EEPROM) && (USE_CLOCKSTRETCH == 0) */
             control |= (1<<TWEA);
             break;
 
         /* illegal state(s) -> reset hardware */
         default:
             control |= (1<<TWSTO);
+            TRACE(TRACE_BUS_ERROR);
+            STATS_INC(STATS_BUS_ERRORS);
             break;
     }
 
     TWCR = (1<<TWINT) | control;
 } /* TWI_vect */
-#endif /* defined (TWCR) */
+#endif /* (USE_UART == 0) && defined (TWCR) */
 
-#if defined (USICR)
+#if (USE_UART == 0) && !defined (TWCR) && defined (USICR)
 /* *************************************************************************
  * usi_statemachine
  * ************************************************************************* */
@@ -605,6 +1970,31 @@ static void usi_statemachine(uint8_t usisr)
     /* Stop Condition detected */
     if (usisr & (1<<USIPF))
     {
+        /* the Stop Condition of other messages on the bus is not traced */
+        if (state != USI_STATE_IDLE)
+        {
+            TRACE(TRACE_STOP);
+        }
+
+        if (TWI_data_pending())
+        {
+#if (USE_CLOCKSTRETCH == 0)
+            /* disable USI and release SCL/SDA: all addresses are NAKed during the write */
+            USICR = 0x00;
+            USI_PIN_RELEASE();
+            TRACE(TRACE_NAK_BUSY);
+            STATS_INC(STATS_NAK_BUSY);
+#endif
+            TWI_data_stop();
+
+#if (USE_CLOCKSTRETCH == 0)
+            USI_PIN_INIT();
+
+            /* conditions of other messages during the write are outdated */
+            usisr = (1<<USISIF) | (1<<USIOIF) | (1<<USIPF);
+#endif
+        }
+
         LED_RT_OFF();
         usi_state = USI_STATE_IDLE;
         state = USI_STATE_IDLE;
@@ -619,17 +2009,41 @@ static void usi_statemachine(uint8_t usisr)
     {
         bcnt = 0;
 
+#if (USE_PIPELINED_EEPROM) && (USE_CLOCKSTRETCH == 0)
+        if (ee_count)
+        {
+            /* NAK own address until eeprom_poll() has written the ring (0xFF matches no address) */
+            data = 0xFF;
+        }
+#endif /* (USE_PIPELINED_EEPROM) && (USE_CLOCKSTRETCH == 0) */
+
         /* SLA+W received -> send ACK */
-        if (data == ((TWI_ADDRESS<<1) | 0x00))
+        if (data == (TWI_SLA | 0x00))
+        {
+            LED_RT_ON();
+            TRACE(TRACE_START);
+#if (TWI_GENERAL_CALL)
+            gcall = 0;
+#endif
+            usi_state = USI_STATE_SLAW_ACK | USI_WAIT_FOR_ACK | USI_ENABLE_SDA_OUTPUT | USI_ENABLE_SCL_HOLD;
+            USIDR = 0x00;
+        }
+#if (TWI_GENERAL_CALL)
+        /* general call (or group address) received -> send ACK */
+        else if (data == TWI_GCALL_SLA)
         {
             LED_RT_ON();
+            TRACE(TRACE_START);
+            gcall = 1;
             usi_state = USI_STATE_SLAW_ACK | USI_WAIT_FOR_ACK | USI_ENABLE_SDA_OUTPUT | USI_ENABLE_SCL_HOLD;
             USIDR = 0x00;
         }
+#endif /* (TWI_GENERAL_CALL) */
         /* SLA+R received -> send ACK */
-        else if (data == ((TWI_ADDRESS<<1) | 0x01))
+        else if (data == (TWI_SLA | 0x01))
         {
             LED_RT_ON();
+            TRACE(TRACE_START);
             usi_state = USI_STATE_SLAR_ACK | USI_WAIT_FOR_ACK | USI_ENABLE_SDA_OUTPUT | USI_ENABLE_SCL_HOLD;
             USIDR = 0x00;
         }
@@ -656,7 +2070,18 @@ static void usi_statemachine(uint8_t usisr)
     /* data received -> send ACK/NAK */
     else if (state == USI_STATE_DATW)
     {
-        if (TWI_data_write(bcnt++, data))
+        uint8_t ack = TWI_data_write(bcnt, data);
+
+#if (BCNT_SATURATE)
+        if (bcnt != 0xFF)
+        {
+            bcnt++;
+        }
+#else
+        bcnt++;
+#endif
+
+        if (ack)
         {
             usi_state = USI_STATE_DATW_ACK | USI_WAIT_FOR_ACK | USI_ENABLE_SDA_OUTPUT | USI_ENABLE_SCL_HOLD;
             USIDR = 0x00;
@@ -727,7 +2152,159 @@ static void usi_statemachine(uint8_t usisr)
         USISR = usisr | ((16 -16)<<USICNT0);
     }
 } /* usi_statemachine */
-#endif /* defined (USICR) */
+#endif /* (USE_UART == 0) && !defined (TWCR) && defined (USICR) */
+
+#if (USE_UART)
+/* *************************************************************************
+ * uart_putc
+ * ************************************************************************* */
+static void uart_putc(uint8_t data)
+{
+    while (!(UART_UCSRA & (1<<UART_UDRE)));
+
+    /* clear TXC, it is set again when the last byte is sent */
+    UART_UCSRA |= (1<<UART_TXC);
+    UART_UDR = data;
+} /* uart_putc */
+
+
+/* *************************************************************************
+ * UART_vect
+ * message frame: SLA+R/W, lenh, lenl, {len bytes if SLA+W}
+ * ************************************************************************* */
+static void UART_vect(void)
+{
+    static uint8_t sla;
+    static uint8_t bcnt;
+    static uint8_t ack;
+    static uint8_t reply;
+    static uint16_t len;
+
+    uint8_t data = UART_UDR;
+    uint8_t state = uart_state & ~UART_TIMEOUT;
+
+    uart_state = state;
+
+    switch (state)
+    {
+        /* Slave Address received -> wait for length */
+        case UART_STATE_SLA:
+            sla = data;
+            uart_state = UART_STATE_LENH;
+            return;
+
+        case UART_STATE_LENH:
+            len = (data << 8);
+            uart_state = UART_STATE_LENL;
+            return;
+
+        case UART_STATE_LENL:
+            len |= data;
+            bcnt = 0;
+            ack = 0x01;
+            reply = UART_ACK;
+            uart_state = UART_STATE_SKIP;
+
+            /* SLA+R received -> send data */
+            if (sla == (TWI_SLA | 0x01))
+            {
+                LED_RT_ON();
+                TRACE(TRACE_START);
+                while (len)
+                {
+                    uart_putc(TWI_data_read(bcnt++));
+                    len--;
+                }
+            }
+            /* SLA+W received -> receive data */
+            else if (sla == (TWI_SLA | 0x00))
+            {
+                LED_RT_ON();
+                TRACE(TRACE_START);
+#if (TWI_GENERAL_CALL)
+                gcall = 0;
+#endif
+                uart_state = UART_STATE_DATW;
+            }
+#if (TWI_GENERAL_CALL)
+            /* general call (or group address) received -> receive data */
+            else if (sla == TWI_GCALL_SLA)
+            {
+                LED_RT_ON();
+                TRACE(TRACE_START);
+                gcall = 1;
+                uart_state = UART_STATE_DATW;
+            }
+#endif /* (TWI_GENERAL_CALL) */
+            break;
+
+        /* data received */
+        case UART_STATE_DATW:
+            if (ack)
+            {
+                /* as with TWI the ACK is for the next byte received */
+                ack = TWI_data_write(bcnt, data);
+
+#if (BCNT_SATURATE)
+                if (bcnt != 0xFF)
+                {
+                    bcnt++;
+                }
+#else
+                bcnt++;
+#endif
+            }
+            else
+            {
+                /* data was not accepted, discard it */
+                reply = UART_NAK;
+            }
+
+            len--;
+            break;
+
+        default:
+            len--;
+            break;
+    }
+
+    /* end of message: same as the Stop Condition */
+    if (len == 0)
+    {
+        if (uart_state == UART_STATE_DATW)
+        {
+            TRACE(TRACE_STOP);
+            if (TWI_data_pending())
+            {
+                TWI_data_stop();
+            }
+
+#if (USE_PIPELINED_EEPROM)
+            /* the next message may not find a full ring */
+            eeprom_sync();
+#endif
+
+#if (TWI_GENERAL_CALL)
+            /* devices are polled one by one after a general call */
+            if (!gcall)
+#endif
+            {
+                /* reply when the write is done, no polling required */
+                uart_putc(reply);
+            }
+
+            /* reply is sent before the application starts */
+            if (cmd == CMD_BOOT_APPLICATION)
+            {
+                while (!(UART_UCSRA & (1<<UART_TXC)));
+            }
+        }
+
+        LED_RT_OFF();
+        uart_state = UART_STATE_SLA;
+    }
+} /* UART_vect */
+#endif /* (USE_UART) */
 
 
 /* *************************************************************************
@@ -741,6 +2318,25 @@ static void TIMER0_OVF_vect(void)
     /* blink LED while running */
     LED_GN_TOGGLE();
 
+#if (TRACE_SUPPORT)
+    /* upper part of the trace timestamp */
+    trace_ovf++;
+#endif
+
+#if (USE_UART)
+    /* incomplete message: host gave up, wait for the next Slave Address */
+    if (uart_state & UART_TIMEOUT)
+    {
+        uart_state = UART_STATE_SLA;
+        TRACE(TRACE_BUS_ERROR);
+        STATS_INC(STATS_BUS_ERRORS);
+    }
+    else if (uart_state != UART_STATE_SLA)
+    {
+        uart_state |= UART_TIMEOUT;
+    }
+#endif /* (USE_UART) */
+
     /* count down for app-boot */
     if (boot_timeout > 1)
     {
@@ -768,7 +2364,9 @@ void init1(void) __attribute__((naked, section(".init1")));
 void init1(void)
 {
   /* make sure r1 is 0x00 */
+#if defined (__AVR__)
   asm volatile ("clr __zero_reg__");
+#endif
 
   /* on some MCUs the stack pointer defaults NOT to RAMEND */
 #if defined(__AVR_ATmega8__) || defined(__AVR_ATmega8515__) || \
@@ -786,17 +2384,57 @@ void init1(void)
  * automagically called on startup
  */
 #if defined (__AVR_ATmega88__) || defined (__AVR_ATmega168__) || \
-    defined (__AVR_ATmega328P__)
+    defined (__AVR_ATmega328P__) || defined (__AVR_ATmega1284P__) || \
+    defined (__AVR_ATmega2560__)
+#if (STATS_SUPPORT)
+/* MCUSR is saved before .bss is cleared */
+static uint8_t reset_cause __attribute__ ((section (".noinit")));
+#define RESET_CAUSE_REG         reset_cause
+#endif
+
 /* *************************************************************************
  * disable_wdt_timer
  * ************************************************************************* */
 void disable_wdt_timer(void) __attribute__((naked, section(".init3")));
 void disable_wdt_timer(void)
 {
+#if (STATS_SUPPORT)
+    reset_cause = MCUSR;
+#endif
     MCUSR = 0;
     WDTCSR = (1<<WDCE) | (1<<WDE);
     WDTCSR = (0<<WDE);
 } /* disable_wdt_timer */
+
+#elif defined (__AVR_ATtiny85__) && (WARMBOOT_SUPPORT)
+/* only the warm boot of the application resets the device via watchdog */
+#if (STATS_SUPPORT)
+/* MCUSR is saved before .bss is cleared */
+static uint8_t reset_cause __attribute__ ((section (".noinit")));
+#define RESET_CAUSE_REG         reset_cause
+#endif
+
+/* *************************************************************************
+ * disable_wdt_timer
+ * ************************************************************************* */
+void disable_wdt_timer(void) __attribute__((naked, section(".init3")));
+void disable_wdt_timer(void)
+{
+#if (STATS_SUPPORT)
+    reset_cause = MCUSR;
+#endif
+    MCUSR = 0;
+    WDTCR = (1<<WDCE) | (1<<WDE);
+    WDTCR = (0<<WDE);
+} /* disable_wdt_timer */
+
+#elif (STATS_SUPPORT)
+/* MCU(C)SR is not cleared by twiboot, read in main() */
+#if defined (MCUCSR)
+#define RESET_CAUSE_REG         MCUCSR
+#else
+#define RESET_CAUSE_REG         MCUSR
+#endif
 #endif
 
 
@@ -806,40 +2444,89 @@ void disable_wdt_timer(void)
 int main(void) __attribute__ ((OS_main, section (".init9")));
 int main(void)
 {
+#if (WARMBOOT_SUPPORT)
+    /* check before anything is pushed onto the stack */
+    uint8_t warmboot = (*(volatile uint16_t *)WARMBOOT_MAGIC_ADDR == WARMBOOT_MAGIC);
+    *(volatile uint16_t *)WARMBOOT_MAGIC_ADDR = 0x0000;
+#endif
+
+#if (ADDRESS_STRAP_SUPPORT)
+    /* enable pullups early, the pins are sampled in read_slave_address() */
+    ADDRESS_STRAP_INIT();
+#endif
+
     LED_INIT();
     LED_GN_ON();
 
+#if (STATS_SUPPORT)
+    stats[STATS_RESET_CAUSE] = RESET_CAUSE_REG;
+#endif
+
 #if (VIRTUAL_BOOT_SECTION)
-	/* load current values (for reading flash) */
-    rstvect_save[0] = pgm_read_byte_near(RSTVECT_ADDR);
-    rstvect_save[1] = pgm_read_byte_near(RSTVECT_ADDR + 1);
-    appvect_save[0] = pgm_read_byte_near(APPVECT_ADDR);
-    appvect_save[1] = pgm_read_byte_near(APPVECT_ADDR + 1);
-#endif /* (VIRTUAL_BOOT_SECTION) */
+    read_vectors();
+#endif
 
-    /* timer0: running with F_CPU/1024 */
-#if defined (TCCR0)
-    TCCR0 = (1<<CS02) | (1<<CS00);
-#elif defined (TCCR0B)
-    TCCR0B = (1<<CS02) | (1<<CS00);
-#else
-#error "TCCR0(B) not defined"
+#if (ADDRESS_EEPROM_SUPPORT) || (ADDRESS_STRAP_SUPPORT)
+    twi_sla = read_slave_address();
 #endif
 
-#if defined (TWCR)
+#if (USE_UART)
+    /* UART init: 8N1 is the reset default */
+    UART_UBRRH = (UART_UBRR_VALUE >> 8) & 0xFF;
+    UART_UBRRL = UART_UBRR_VALUE & 0xFF;
+    UART_UCSRA = (1<<UART_U2X);
+    UART_UCSRB = (1<<UART_RXEN) | (1<<UART_TXEN);
+#elif defined (TWCR)
     /* TWI init: set address, auto ACKs */
-    TWAR = (TWI_ADDRESS<<1);
+#if (TWI_GROUP_ADDRESS != 0x00)
+    /* own and group address differ in the masked bits */
+    TWAR = TWI_SLA;
+    TWAMR = TWI_SLA ^ TWI_GCALL_SLA;
+#elif (TWI_GENERAL_CALL)
+    TWAR = TWI_SLA | (1<<TWGCE);
+#else
+    TWAR = TWI_SLA;
+#endif
     TWCR = (1<<TWEA) | (1<<TWEN);
 #elif defined (USICR)
     USI_PIN_INIT();
     usi_statemachine(0x00);
 #else
 #error "No TWI/USI peripheral found"
+#endif
+
+#if (WARMBOOT_SUPPORT)
+    if (warmboot)
+    {
+        /* application requested an update -> stay in bootloader */
+        boot_timeout = 0;
+    }
+    else
+#endif
+    {
+#if (APPINFO_SUPPORT)
+        /* TWI/USI is already active, a master is served after the check */
+        check_appinfo();
+#endif
+    }
+
+    /* timer0: running with F_CPU/1024 */
+#if defined (TCCR0)
+    TCCR0 = (1<<CS02) | (1<<CS00);
+#elif defined (TCCR0B)
+    TCCR0B = (1<<CS02) | (1<<CS00);
+#else
+#error "TCCR0(B) not defined"
 #endif
 
     while (cmd != CMD_BOOT_APPLICATION)
     {
-#if defined (TWCR)
+#if (USE_UART)
+        if (UART_UCSRA & (1<<UART_RXC))
+        {
+            UART_vect();
+        }
+#elif defined (TWCR)
         if (TWCR & (1<<TWINT))
         {
             TWI_vect();
@@ -865,10 +2552,31 @@ int main(void)
         }
 #else
 #error "TIFR(0) not defined"
+#endif
+
+#if (USE_PIPELINED_WRITE)
+        flash_poll();
+#endif
+
+#if (USE_PIPELINED_EEPROM)
+        eeprom_poll();
 #endif
     }
 
-#if defined (TWCR)
+#if (USE_PIPELINED_EEPROM)
+    /* write remaining eeprom bytes before leaving the bootloader */
+    eeprom_sync();
+#endif
+
+#if (USE_PIPELINED_WRITE)
+    /* finish last page write before leaving the bootloader */
+    flash_sync();
+#endif
+
+#if (USE_UART)
+    /* Disable UART */
+    UART_UCSRB = 0x00;
+#elif defined (TWCR)
     /* Disable TWI but keep address! */
     TWCR = 0x00;
 #elif defined (USICR)
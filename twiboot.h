@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   Copyright (C) 10/2026 by agent                                        *
+ *   agent@local                                                           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; version 2 of the License,               *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef _TWIBOOT_H_
+#define _TWIBOOT_H_
+
+/*
+ * twiboot protocol definitions
+ * shared by bootloader, application (app/) and host tool (linux/)
+ */
+
+/* SLA+R */
+#define CMD_WAIT                0x00
+#define CMD_READ_VERSION        0x01
+#define CMD_ACCESS_MEMORY       0x02
+
+/* SLA+W */
+#define CMD_SWITCH_APPLICATION  CMD_READ_VERSION
+
+/* CMD_SWITCH_APPLICATION parameter */
+#define BOOTTYPE_BOOTLOADER     0x00    /* only in APP */
+#define BOOTTYPE_APPLICATION    0x80
+
+/* CMD_{READ|WRITE}_* parameter */
+#define MEMTYPE_CHIPINFO        0x00
+#define MEMTYPE_FLASH           0x01
+#define MEMTYPE_EEPROM          0x02
+#define MEMTYPE_FLASH_CRC       0x03
+#define MEMTYPE_FLASH_RLE       0x04
+#define MEMTYPE_APPINFO         0x05
+#define MEMTYPE_WRITE_STATUS    0x06
+#define MEMTYPE_PAGEBUF         0x07
+#define MEMTYPE_PAGEBUF_COMMIT  0x08
+#define MEMTYPE_FLASH_ERASE     0x09
+#define MEMTYPE_JOURNAL         0x0A
+#define MEMTYPE_TRACE           0x0B
+#define MEMTYPE_STATS           0x0C
+
+/* memtype flag: 3byte address (flash above 64KiB) */
+#define MEMTYPE_ADDR24          0x80
+
+/* MEMTYPE_WRITE_STATUS bits */
+#define WRITE_STATUS_OK                 0x00
+#define WRITE_STATUS_VERIFY_FAILED      0x01    /* flash content differs after page write */
+#define WRITE_STATUS_ADDRESS_REJECTED   0x02    /* page in bootloader section, not written */
+#define WRITE_STATUS_INCOMPLETE         0x04    /* compressed page ended within page or run, not written */
+
+/* UART transport: reply to a write message (SLA+W) */
+#define UART_ACK                0x06
+#define UART_NAK                0x15
+
+/* MEMTYPE_JOURNAL: 2byte image id, 2byte page count, 2byte committed pages */
+#define JOURNAL_LENGTH          6
+
+/* MEMTYPE_TRACE: 1byte event, 2byte timer overflows, 1byte TCNT0 per entry
+ * time in 128us ticks: overflows * TRACE_TICKS_PER_OVF + TCNT0 - (0xFF - TRACE_TICKS_PER_OVF)
+ */
+#define TRACE_ENTRY_SIZE        4
+#define TRACE_TICKS_PER_OVF     195
+#define TRACE_TICK_US           128
+
+#define TRACE_NONE              0x00    /* unused entry */
+#define TRACE_START             0x01    /* addressed by SLA+W / SLA+R / general call */
+#define TRACE_STOP              0x02    /* Stop Condition / repeated Start after a write */
+#define TRACE_COMMIT_BEGIN      0x03    /* flash page write started */
+#define TRACE_COMMIT_END        0x04    /* flash page write done */
+#define TRACE_NAK_BUSY          0x05    /* own address NAKed until the pending write is done */
+#define TRACE_BUS_ERROR         0x06    /* illegal TWI state / incomplete UART message */
+
+/* MEMTYPE_STATS: offsets in the statistics block, counters msb first */
+#define STATS_RESET_CAUSE       0       /* 1byte MCUSR on startup */
+#define STATS_PAGES             1       /* 2byte flash pages written */
+#define STATS_EEPROM_BYTES      3       /* 2byte eeprom bytes written */
+#define STATS_NAK_BUSY          5       /* 2byte own address NAKed while a write is pending */
+#define STATS_BUS_ERRORS        7       /* 2byte illegal TWI states / incomplete UART messages */
+#define STATS_SPM_TICKS         9       /* 4byte flash page erase + write time in TRACE_TICK_US */
+#define STATS_LENGTH            13
+
+/* warm boot: application stores magic at the top of the RAM, followed by a watchdog reset */
+#define WARMBOOT_MAGIC_ADDR     (RAMEND -1)
+#define WARMBOOT_MAGIC          0xB007
+
+#endif /* _TWIBOOT_H_ */